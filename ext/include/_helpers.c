@@ -320,6 +320,21 @@ optstringfield(lua_State *L, int index, const char *k, const char *def)
 	return checkstringfield(L, index, k);
 }
 
+static int
+optbooleanfield(lua_State *L, int index, const char *k, int def)
+{
+	int got_type, r;
+	lua_getfield(L, index, k);
+	got_type = lua_type(L, -1);
+	lua_pop(L, 1);
+	if (got_type == LUA_TNONE || got_type == LUA_TNIL)
+		return def;
+	checkfieldtype(L, index, k, LUA_TBOOLEAN, NULL);
+	r = lua_toboolean(L, -1);
+	lua_pop(L, 1);
+	return r;
+}
+
 static int
 pusherror(lua_State *L, const char *info)
 {
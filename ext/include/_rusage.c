@@ -0,0 +1,62 @@
+/*
+ * POSIX library for Lua 5.1, 5.2, 5.3 & 5.4.
+ * Copyright (C) 2013-2025 Gary V. Vaughan
+ * Copyright (C) 2010-2013 Reuben Thomas <rrt@sc3d.org>
+ * Copyright (C) 2008-2010 Natanael Copa <natanael.copa@gmail.com>
+ * Clean up and bug fixes by Leo Razoumov <slonik.az@gmail.com> 2006-10-11
+ * Luiz Henrique de Figueiredo <lhf@tecgraf.puc-rio.br> 07 Apr 2006 23:17:49
+ * Based on original by Claudio Terra for Lua 3.x.
+ * With contributions by Roberto Ierusalimschy.
+ * With documentation from Steve Donovan 2012
+ */
+
+#ifndef LUAPOSIX__RUSAGE_C
+#define LUAPOSIX__RUSAGE_C 1
+
+#include <sys/resource.h>
+
+#include "_helpers.c"
+
+
+static void
+pushrusage_timeval(lua_State *L, const char *k, struct timeval *tv)
+{
+	lua_createtable(L, 0, 2);
+	setintegerfield(tv, tv_sec);
+	setintegerfield(tv, tv_usec);
+	settypemetatable("PosixTimeval");
+	lua_setfield(L, -2, k);
+}
+
+
+/* Push a PosixRusage table, as documented in posix.sys.resource, for *ru*. */
+static int
+pushrusage(lua_State *L, struct rusage *ru)
+{
+	if (!ru)
+		return lua_pushnil(L), 1;
+
+	lua_createtable(L, 0, 16);
+
+	pushrusage_timeval(L, "ru_utime", &ru->ru_utime);
+	pushrusage_timeval(L, "ru_stime", &ru->ru_stime);
+	setintegerfield(ru, ru_maxrss);
+	setintegerfield(ru, ru_ixrss);
+	setintegerfield(ru, ru_idrss);
+	setintegerfield(ru, ru_isrss);
+	setintegerfield(ru, ru_minflt);
+	setintegerfield(ru, ru_majflt);
+	setintegerfield(ru, ru_nswap);
+	setintegerfield(ru, ru_inblock);
+	setintegerfield(ru, ru_oublock);
+	setintegerfield(ru, ru_msgsnd);
+	setintegerfield(ru, ru_msgrcv);
+	setintegerfield(ru, ru_nsignals);
+	setintegerfield(ru, ru_nvcsw);
+	setintegerfield(ru, ru_nivcsw);
+
+	settypemetatable("PosixRusage");
+	return 1;
+}
+
+#endif /*LUAPOSIX__RUSAGE_C*/
@@ -0,0 +1,51 @@
+/*
+ * POSIX library for Lua 5.1, 5.2, 5.3 & 5.4.
+ * Copyright (C) 2013-2025 Gary V. Vaughan
+ * Copyright (C) 2010-2013 Reuben Thomas <rrt@sc3d.org>
+ * Copyright (C) 2008-2010 Natanael Copa <natanael.copa@gmail.com>
+ * Clean up and bug fixes by Leo Razoumov <slonik.az@gmail.com> 2006-10-11
+ * Luiz Henrique de Figueiredo <lhf@tecgraf.puc-rio.br> 07 Apr 2006 23:17:49
+ * Based on original by Claudio Terra for Lua 3.x.
+ * With contributions by Roberto Ierusalimschy.
+ * With documentation from Steve Donovan 2012
+ */
+
+#ifndef LUAPOSIX__STAT_C
+#define LUAPOSIX__STAT_C 1
+
+#include <sys/stat.h>
+
+#include "_helpers.c"
+
+
+/* Push a PosixStat table, as documented in posix.sys.stat, for *st*. */
+static int
+pushstat(lua_State *L, struct stat *st)
+{
+	if (!st)
+		return lua_pushnil(L), 1;
+
+	lua_createtable(L, 0, 13);
+
+	setintegerfield(st, st_dev);
+	setintegerfield(st, st_ino);
+	setintegerfield(st, st_mode);
+	setintegerfield(st, st_nlink);
+	setintegerfield(st, st_uid);
+	setintegerfield(st, st_gid);
+	setintegerfield(st, st_rdev);
+	setintegerfield(st, st_size);
+	setintegerfield(st, st_blksize);
+	setintegerfield(st, st_blocks);
+
+	/* st_[amc]time is a macro on at least Mac OS, so we have to
+	   assign field name strings manually. */
+        pushintegerfield("st_atime", st->st_atime);
+        pushintegerfield("st_mtime", st->st_mtime);
+        pushintegerfield("st_ctime", st->st_ctime);
+
+	settypemetatable("PosixStat");
+	return 1;
+}
+
+#endif /*LUAPOSIX__STAT_C*/
@@ -0,0 +1,402 @@
+/*
+ * POSIX library for Lua 5.1, 5.2, 5.3 & 5.4.
+ * Copyright (C) 2013-2025 Gary V. Vaughan
+ * Copyright (C) 2010-2013 Reuben Thomas <rrt@sc3d.org>
+ * Copyright (C) 2008-2010 Natanael Copa <natanael.copa@gmail.com>
+ * Clean up and bug fixes by Leo Razoumov <slonik.az@gmail.com> 2006-10-11
+ * Luiz Henrique de Figueiredo <lhf@tecgraf.puc-rio.br> 07 Apr 2006 23:17:49
+ * Based on original by Claudio Terra for Lua 3.x.
+ * With contributions by Roberto Ierusalimschy.
+ * With documentation from Steve Donovan 2012
+ */
+/***
+ Deadline Queues.
+
+ A queue of pending deadlines, such as per-connection idle, read and
+ write timeouts, kept in a 4-ary min-heap so that the earliest deadline
+ is always available without scanning every timer.  Adding or
+ cancelling a deadline costs O(log n), and finding the next deadline is
+ O(1).
+
+ Deadlines are plain integers on whatever scale the caller chooses,
+ typically nanoseconds from `posix.time.clock_gettime(CLOCK_MONOTONIC)`.
+ For convenience, anywhere a deadline is expected a
+ @{posix.time.PosixTimespec} table is also accepted, and is converted
+ to nanoseconds.
+
+@module posix.deadline
+*/
+
+#include "_helpers.c"
+
+
+/* Low bits of a timer id hold its slot index, and the remaining bits a
+   generation count, so that cancelling a stale id is harmless even after
+   its slot has been reused.  Ids stay below 2^53 to survive conversion to
+   a double on Lua 5.1 and 5.2. */
+#define DLQ_SLOT_BITS	24
+#define DLQ_SLOT_MAX	((1u << DLQ_SLOT_BITS) - 1)
+#define DLQ_GEN_MASK	((1u << 28) - 1)
+#define DLQ_ARITY	4
+
+#define DLQ_HANDLE	PACKAGE " deadline queue"
+
+typedef struct
+{
+	lua_Integer	when;
+	unsigned	slot;
+} dlq_node;
+
+typedef struct
+{
+	size_t		pos;	/* index into heap, while live */
+	unsigned	gen;
+	unsigned	next;	/* next free slot + 1, while free */
+	int		live;
+} dlq_slot;
+
+typedef struct
+{
+	dlq_node	*heap;
+	size_t		n, heapcap;
+	dlq_slot	*slots;
+	size_t		nslots, slotcap;
+	unsigned	freelist;	/* first free slot + 1, or 0 */
+} dlq;
+
+
+static dlq *
+checkdlq(lua_State *L, int narg)
+{
+	return (dlq *)luaL_checkudata(L, narg, DLQ_HANDLE);
+}
+
+
+static lua_Integer
+checkdeadline(lua_State *L, int narg)
+{
+	if (lua_type(L, narg) == LUA_TTABLE)
+		return optintegerfield(L, narg, "tv_sec", 0) * 1000000000
+		     + optintegerfield(L, narg, "tv_nsec", 0);
+	return expectinteger(L, narg, "integer or PosixTimespec");
+}
+
+
+static lua_Integer
+dlq_id(dlq *q, unsigned slot)
+{
+	return (lua_Integer)q->slots[slot].gen * (DLQ_SLOT_MAX + 1) + slot + 1;
+}
+
+
+static void *
+dlq_grow(lua_State *L, void *p, size_t *cap, size_t size)
+{
+	void *ud;
+	lua_Alloc lalloc = lua_getallocf(L, &ud);
+	size_t newcap = *cap ? *cap * 2 : 64;
+	void *r = lalloc(ud, p, *cap * size, newcap * size);
+	if (r == NULL)
+		luaL_error(L, "not enough memory");
+	*cap = newcap;
+	return r;
+}
+
+
+static void
+dlq_place(dlq *q, size_t i, dlq_node node)
+{
+	q->heap[i] = node;
+	q->slots[node.slot].pos = i;
+}
+
+
+static void
+dlq_siftup(dlq *q, size_t i)
+{
+	dlq_node node = q->heap[i];
+	while (i > 0)
+	{
+		size_t parent = (i - 1) / DLQ_ARITY;
+		if (q->heap[parent].when <= node.when)
+			break;
+		dlq_place(q, i, q->heap[parent]);
+		i = parent;
+	}
+	dlq_place(q, i, node);
+}
+
+
+static void
+dlq_siftdown(dlq *q, size_t i)
+{
+	dlq_node node = q->heap[i];
+	for (;;)
+	{
+		size_t child = i * DLQ_ARITY + 1, best = i, last, c;
+		lua_Integer bestwhen = node.when;
+		if (child >= q->n)
+			break;
+		last = child + DLQ_ARITY < q->n ? child + DLQ_ARITY : q->n;
+		for (c = child; c < last; c++)
+			if (q->heap[c].when < bestwhen)
+			{
+				best = c;
+				bestwhen = q->heap[c].when;
+			}
+		if (best == i)
+			break;
+		dlq_place(q, i, q->heap[best]);
+		i = best;
+	}
+	dlq_place(q, i, node);
+}
+
+
+/* Remove heap entry i, and release its slot. */
+static void
+dlq_remove(dlq *q, size_t i)
+{
+	dlq_slot *s = &q->slots[q->heap[i].slot];
+	s->live = 0;
+	s->gen = (s->gen + 1) & DLQ_GEN_MASK;
+	s->next = q->freelist;
+	q->freelist = q->heap[i].slot + 1;
+
+	if (--q->n > i)
+	{
+		dlq_place(q, i, q->heap[q->n]);
+		if (i > 0 && q->heap[(i - 1) / DLQ_ARITY].when > q->heap[i].when)
+			dlq_siftup(q, i);
+		else
+			dlq_siftdown(q, i);
+	}
+}
+
+
+static int
+dlq_gc(lua_State *L)
+{
+	dlq *q = (dlq *)lua_touserdata(L, 1);
+	void *ud;
+	lua_Alloc lalloc = lua_getallocf(L, &ud);
+	if (q->heap != NULL)
+		lalloc(ud, q->heap, q->heapcap * sizeof *q->heap, 0);
+	if (q->slots != NULL)
+		lalloc(ud, q->slots, q->slotcap * sizeof *q->slots, 0);
+	memset(q, 0, sizeof *q);
+	return 0;
+}
+
+
+/***
+Schedule a deadline.
+@function add
+@tparam int|posix.time.PosixTimespec deadline when *tag* becomes due
+@param tag any non-nil value to return from @{expire} when due
+@treturn int timer id, for use with @{cancel}
+@usage id = queue:add(now + 30 * 1000000000, conn)
+*/
+static int
+dlq_add(lua_State *L)
+{
+	dlq *q = checkdlq(L, 1);
+	lua_Integer when = checkdeadline(L, 2);
+	unsigned slot;
+	luaL_argcheck(L, !lua_isnoneornil(L, 3), 3, "non-nil value expected");
+	checknargs(L, 3);
+
+	if (q->freelist)
+	{
+		slot = q->freelist - 1;
+		q->freelist = q->slots[slot].next;
+	}
+	else
+	{
+		if (q->nslots > DLQ_SLOT_MAX)
+			return luaL_error(L, "too many pending deadlines");
+		if (q->nslots == q->slotcap)
+			q->slots = dlq_grow(L, q->slots, &q->slotcap, sizeof *q->slots);
+		slot = (unsigned)q->nslots++;
+		q->slots[slot].gen = 0;
+	}
+	if (q->n == q->heapcap)
+		q->heap = dlq_grow(L, q->heap, &q->heapcap, sizeof *q->heap);
+
+	q->slots[slot].live = 1;
+	q->heap[q->n].when = when;
+	q->heap[q->n].slot = slot;
+	dlq_siftup(q, q->n++);
+
+	/* tags[slot + 1] = tag */
+	lua_getuservalue(L, 1);
+	lua_pushvalue(L, 3);
+	lua_rawseti(L, -2, slot + 1);
+	lua_pop(L, 1);
+
+	lua_pushinteger(L, dlq_id(q, slot));
+	return 1;
+}
+
+
+/***
+Cancel a scheduled deadline.
+Cancelling an id that has already expired or been cancelled does nothing.
+@function cancel
+@int id timer id returned by @{add}
+@treturn boolean `true` if a pending deadline was cancelled, otherwise `false`
+*/
+static int
+dlq_cancel(lua_State *L)
+{
+	dlq *q = checkdlq(L, 1);
+	lua_Integer id = checkinteger(L, 2);
+	unsigned slot;
+	checknargs(L, 2);
+
+	if (id < 1)
+		return pushboolresult(0);
+	slot = (unsigned)((id - 1) & DLQ_SLOT_MAX);
+	if (slot >= q->nslots || !q->slots[slot].live || dlq_id(q, slot) != id)
+		return pushboolresult(0);
+
+	dlq_remove(q, q->slots[slot].pos);
+	lua_getuservalue(L, 1);
+	lua_pushnil(L);
+	lua_rawseti(L, -2, slot + 1);
+	return pushboolresult(1);
+}
+
+
+/***
+Remove and return every tag whose deadline is not later than *now*.
+@function expire
+@tparam int|posix.time.PosixTimespec now current time
+@int[opt] max return no more than this many tags
+@treturn table list of due tags, earliest deadline first
+@treturn int number of tags in the list
+@usage
+  for _, conn in ipairs(queue:expire(now)) do conn:close() end
+*/
+static int
+dlq_expire(lua_State *L)
+{
+	dlq *q = checkdlq(L, 1);
+	lua_Integer now = checkdeadline(L, 2);
+	lua_Integer max = optinteger(L, 3, -1);
+	int n = 0;
+	checknargs(L, 3);
+
+	lua_getuservalue(L, 1);
+	lua_newtable(L);
+	while (q->n > 0 && q->heap[0].when <= now && (max < 0 || n < max))
+	{
+		unsigned slot = q->heap[0].slot;
+		dlq_remove(q, 0);
+
+		/* result[++n] = tags[slot + 1]; tags[slot + 1] = nil */
+		lua_rawgeti(L, -2, slot + 1);
+		lua_rawseti(L, -2, ++n);
+		lua_pushnil(L);
+		lua_rawseti(L, -3, slot + 1);
+	}
+	lua_pushinteger(L, n);
+	return 2;
+}
+
+
+/***
+Earliest pending deadline.
+@function next_deadline
+@treturn[1] int earliest deadline, if any are pending
+@return[2] nil if the queue is empty
+@usage
+  local deadline = queue:next_deadline()
+  local timeout = deadline and (deadline - now) // 1000000 or -1
+*/
+static int
+dlq_next_deadline(lua_State *L)
+{
+	dlq *q = checkdlq(L, 1);
+	checknargs(L, 1);
+	if (q->n == 0)
+		return lua_pushnil(L), 1;
+	return pushintegerresult(q->heap[0].when);
+}
+
+
+/***
+Number of pending deadlines.
+Also available as `#queue`.
+@function size
+@treturn int number of pending deadlines
+*/
+static int
+dlq_size(lua_State *L)
+{
+	dlq *q = checkdlq(L, 1);
+	return pushintegerresult(q->n);
+}
+
+
+static const luaL_Reg dlq_methods[] =
+{
+	{"add",			dlq_add},
+	{"cancel",		dlq_cancel},
+	{"expire",		dlq_expire},
+	{"next_deadline",	dlq_next_deadline},
+	{"size",		dlq_size},
+	{NULL, NULL}
+};
+
+
+/***
+Create a new, empty deadline queue.
+@function new
+@return a deadline queue, with methods @{add}, @{cancel}, @{expire},
+  @{next_deadline} and @{size}
+@usage
+  local deadline = require "posix.deadline"
+  local queue = deadline.new()
+*/
+static int
+Pnew(lua_State *L)
+{
+	dlq *q;
+	checknargs(L, 0);
+	q = (dlq *)lua_newuserdata(L, sizeof *q);
+	memset(q, 0, sizeof *q);
+	if (luaL_newmetatable(L, DLQ_HANDLE))
+	{
+		luaL_newlib(L, dlq_methods);
+		lua_setfield(L, -2, "__index");
+		lua_pushcfunction(L, dlq_size);
+		lua_setfield(L, -2, "__len");
+		lua_pushcfunction(L, dlq_gc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_setmetatable(L, -2);
+
+	/* Tags live in the uservalue table, indexed by slot + 1. */
+	lua_newtable(L);
+	lua_setuservalue(L, -2);
+	return 1;
+}
+
+
+static const luaL_Reg posix_deadline_fns[] =
+{
+	LPOSIX_FUNC( Pnew		),
+	{NULL, NULL}
+};
+
+
+LUALIB_API int
+luaopen_posix_deadline(lua_State *L)
+{
+	luaL_newlib(L, posix_deadline_fns);
+	lua_pushstring(L, LPOSIX_VERSION_STRING("deadline"));
+	lua_setfield(L, -2, "version");
+
+	return 1;
+}
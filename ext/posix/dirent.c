@@ -16,8 +16,40 @@
 */
 
 #include <dirent.h>
+#include <fcntl.h>
 
 #include "_helpers.c"
+#include "_stat.c"
+
+
+/* d_type is not required by POSIX: where it is missing, report every
+   entry as DT_UNKNOWN so that callers fall back to lstat. */
+#ifdef DT_UNKNOWN
+#  define entry_type(e)	((e)->d_type)
+#else
+#  define DT_UNKNOWN	0
+#  define DT_FIFO	1
+#  define DT_CHR	2
+#  define DT_DIR	4
+#  define DT_BLK	6
+#  define DT_REG	8
+#  define DT_LNK	10
+#  define DT_SOCK	12
+#  define entry_type(e)	DT_UNKNOWN
+#endif
+
+static int
+mode_type(mode_t mode)
+{
+	if (S_ISREG(mode))	return DT_REG;
+	if (S_ISDIR(mode))	return DT_DIR;
+	if (S_ISLNK(mode))	return DT_LNK;
+	if (S_ISCHR(mode))	return DT_CHR;
+	if (S_ISBLK(mode))	return DT_BLK;
+	if (S_ISFIFO(mode))	return DT_FIFO;
+	if (S_ISSOCK(mode))	return DT_SOCK;
+	return DT_UNKNOWN;
+}
 
 
 /***
@@ -76,6 +108,28 @@ aux_files(lua_State *L)
 }
 
 
+static int
+aux_files_type(lua_State *L)
+{
+	DIR **p = (DIR **)lua_touserdata(L, lua_upvalueindex(1));
+	DIR *d = *p;
+	struct dirent *entry;
+	if (d == NULL)
+		return 0;
+	entry = readdir(d);
+	if (entry == NULL)
+	{
+		closedir(d);
+		*p=NULL;
+		return 0;
+	}
+	lua_pushstring(L, entry->d_name);
+	lua_pushinteger(L, entry_type(entry));
+	lua_pushinteger(L, entry->d_ino);
+	return 3;
+}
+
+
 static int
 dir_gc (lua_State *L)
 {
@@ -86,18 +140,39 @@ dir_gc (lua_State *L)
 }
 
 
+static const char *Sfiles_fields[] = { "type" };
+
 /***
 Iterator over all files in named directory.
+With *opts.type*, the iterator also returns the entry type and inode
+number that `readdir` reports, so that callers can often classify an
+entry without a separate `lstat`.  The type is `DT_UNKNOWN` where the
+file system does not supply it.
 @function files
 @string[opt="."] path directory to act on
-@return an iterator
+@tparam[opt] table opts iteration options, where a true `type` field
+  selects the extended results
+@return an iterator, returning each entry name, and with *opts.type* its
+  `DT_*` type and inode number
+@usage
+  local dirent = require "posix.dirent"
+  for name, d_type, ino in dirent.files(".", {type=true}) do
+    if d_type == dirent.DT_DIR then print(name .. "/", ino) end
+  end
 */
 static int
 Pfiles(lua_State *L)
 {
 	const char *path = optstring(L, 1, ".");
+	int wanttype = 0;
 	DIR **d;
-	checknargs(L, 1);
+	checknargs(L, 2);
+	if (!lua_isnoneornil(L, 2))
+	{
+		luaL_checktype(L, 2, LUA_TTABLE);
+		wanttype = optbooleanfield(L, 2, "type", 0);
+		checkfieldnames(L, 2, Sfiles_fields);
+	}
 	d = (DIR **)lua_newuserdata(L, sizeof(DIR *));
 	*d = opendir(path);
 	/* Throw an argument error for consistency with eg. io.lines */
@@ -113,7 +188,337 @@ Pfiles(lua_State *L)
 		lua_setfield(L, -2, "__gc");
 	}
 	lua_setmetatable(L, -2);
-	lua_pushcclosure(L, aux_files, 1);
+	lua_pushcclosure(L, wanttype ? aux_files_type : aux_files, 1);
+	return 1;
+}
+
+
+#define WALK_HANDLE	PACKAGE " walk handle"
+
+typedef struct
+{
+	DIR		*d;
+	size_t		pathlen;	/* length of this directory's path */
+	dev_t		dev;
+	ino_t		ino;
+	int		depth;
+} walk_frame;
+
+typedef struct
+{
+	walk_frame	*frames;
+	size_t		nframes, framecap;
+	char		*path;
+	size_t		pathcap;
+	int		maxdepth, postorder, xdev, follow, wantstat;
+	dev_t		rootdev;
+	int		started;
+} walk_state;
+
+
+static void *
+walk_grow(lua_State *L, void *p, size_t *cap, size_t need, size_t size)
+{
+	void *ud;
+	lua_Alloc lalloc = lua_getallocf(L, &ud);
+	size_t newcap = *cap ? *cap : 64;
+	void *r;
+	if (need <= *cap)
+		return p;
+	while (newcap < need)
+		newcap *= 2;
+	if ((r = lalloc(ud, p, *cap * size, newcap * size)) == NULL)
+		luaL_error(L, "not enough memory");
+	*cap = newcap;
+	return r;
+}
+
+
+static void
+walk_pop(walk_state *w)
+{
+	walk_frame *f = &w->frames[--w->nframes];
+	closedir(f->d);
+	w->path[f->pathlen] = '\0';
+}
+
+
+static int
+walk_gc(lua_State *L)
+{
+	walk_state *w = (walk_state *)lua_touserdata(L, 1);
+	void *ud;
+	lua_Alloc lalloc = lua_getallocf(L, &ud);
+	while (w->nframes > 0)
+		walk_pop(w);
+	if (w->frames != NULL)
+		lalloc(ud, w->frames, w->framecap * sizeof *w->frames, 0);
+	if (w->path != NULL)
+		lalloc(ud, w->path, w->pathcap, 0);
+	memset(w, 0, sizeof *w);
+	return 0;
+}
+
+
+/* Open directory *name* relative to *dirfd* (or AT_FDCWD), and push a
+   frame for it.  Returns 0 if the directory cannot be entered. */
+static int
+walk_push(lua_State *L, walk_state *w, int dirfd, const char *name, int depth)
+{
+	int fd, flags = O_RDONLY | O_DIRECTORY;
+	struct stat st;
+	DIR *d;
+	size_t i;
+
+#ifdef O_CLOEXEC
+	flags |= O_CLOEXEC;
+#endif
+	if (!w->follow && depth > 0)
+		flags |= O_NOFOLLOW;
+	if ((fd = openat(dirfd, name, flags)) == -1)
+		return 0;
+	if (fstat(fd, &st) == -1 || (w->xdev && depth > 0 && st.st_dev != w->rootdev))
+	{
+		close(fd);
+		return 0;
+	}
+	/* Following symlinks can lead back to an ancestor. */
+	for (i = 0; w->follow && i < w->nframes; i++)
+		if (w->frames[i].dev == st.st_dev && w->frames[i].ino == st.st_ino)
+		{
+			close(fd);
+			return 0;
+		}
+	if ((d = fdopendir(fd)) == NULL)
+	{
+		close(fd);
+		return 0;
+	}
+
+	w->frames = walk_grow(L, w->frames, &w->framecap, w->nframes + 1, sizeof *w->frames);
+	w->frames[w->nframes].d = d;
+	w->frames[w->nframes].pathlen = strlen(w->path);
+	w->frames[w->nframes].dev = st.st_dev;
+	w->frames[w->nframes].ino = st.st_ino;
+	w->frames[w->nframes].depth = depth;
+	w->nframes++;
+	if (depth == 0)
+		w->rootdev = st.st_dev;
+	return 1;
+}
+
+
+/* Call opts.prune(path, d_type, stat), which is stored as the iterator's
+   second upvalue, and return its truthiness. */
+static int
+walk_prune(lua_State *L, walk_state *w, int type, struct stat *st)
+{
+	int r;
+	if (lua_isnil(L, lua_upvalueindex(2)))
+		return 0;
+	lua_pushvalue(L, lua_upvalueindex(2));
+	lua_pushstring(L, w->path);
+	lua_pushinteger(L, type);
+	if (st)
+		pushstat(L, st);
+	else
+		lua_pushnil(L);
+	lua_call(L, 3, 1);
+	r = lua_toboolean(L, -1);
+	lua_pop(L, 1);
+	return r;
+}
+
+
+static int
+walk_result(lua_State *L, const char *path, int type, struct stat *st)
+{
+	lua_pushstring(L, path);
+	lua_pushinteger(L, type);
+	if (st == NULL)
+		return 2;
+	return 2 + pushstat(L, st);
+}
+
+
+static int
+aux_walk(lua_State *L)
+{
+	walk_state *w = (walk_state *)lua_touserdata(L, lua_upvalueindex(1));
+	struct stat st;
+	struct dirent *entry;
+
+	if (!w->started)
+	{
+		int type, descend;
+		w->started = 1;
+		if ((w->follow ? stat : lstat)(w->path, &st) == -1)
+			return 0;
+		type = mode_type(st.st_mode);
+		descend = type == DT_DIR && w->maxdepth != 0
+			&& !walk_prune(L, w, type, w->wantstat ? &st : NULL)
+			&& walk_push(L, w, AT_FDCWD, w->path, 0);
+		if (!descend || !w->postorder)
+			return walk_result(L, w->path, type, w->wantstat ? &st : NULL);
+	}
+
+	while (w->nframes > 0)
+	{
+		walk_frame *f = &w->frames[w->nframes - 1];
+		size_t base = f->pathlen, len;
+		int type, depth = f->depth + 1, fd = dirfd(f->d), havestat = 0;
+
+		if ((entry = readdir(f->d)) == NULL)
+		{
+			if (w->postorder)
+				havestat = w->wantstat && fstat(fd, &st) == 0;
+			walk_pop(w);
+			if (w->postorder)
+				return walk_result(L, w->path, DT_DIR, havestat ? &st : NULL);
+			continue;
+		}
+		if (STREQ(entry->d_name, ".") || STREQ(entry->d_name, ".."))
+			continue;
+
+		/* path = path .. "/" .. d_name, without doubling a trailing "/" */
+		len = strlen(entry->d_name);
+		w->path = walk_grow(L, w->path, &w->pathcap, base + len + 2, 1);
+		if (base == 0 || w->path[base - 1] != '/')
+			w->path[base++] = '/';
+		memcpy(w->path + base, entry->d_name, len + 1);
+
+		/* Only stat when d_type cannot answer the question. */
+		type = entry_type(entry);
+		if (w->wantstat || type == DT_UNKNOWN || (w->follow && type == DT_LNK))
+		{
+			int flags = w->follow ? 0 : AT_SYMLINK_NOFOLLOW;
+			if (fstatat(fd, entry->d_name, &st, flags) == 0)
+			{
+				havestat = w->wantstat;
+				type = mode_type(st.st_mode);
+			}
+		}
+
+		if (type == DT_DIR && (w->maxdepth < 0 || depth < w->maxdepth)
+			&& !walk_prune(L, w, type, havestat ? &st : NULL)
+			&& walk_push(L, w, fd, entry->d_name, depth))
+		{
+			/* Now inside the new directory, whose path is w->path. */
+			if (w->postorder)
+				continue;
+			return walk_result(L, w->path, type, havestat ? &st : NULL);
+		}
+		else
+		{
+			/* Return this entry, and trim back to the parent's path
+			   ready for the next readdir. */
+			int r = walk_result(L, w->path, type, havestat ? &st : NULL);
+			w->path[f->pathlen] = '\0';
+			return r;
+		}
+	}
+	return 0;
+}
+
+
+static const char *Swalk_fields[] = {
+	"follow", "maxdepth", "order", "prune", "stat", "xdev"
+};
+
+/***
+Iterator over every entry in a directory tree.
+Descends into subdirectories using `openat` relative to the parent
+descriptor, and uses the `d_type` returned by `readdir` to avoid calling
+`lstat` for every entry, except where the file system does not supply it
+or the caller asks for *opts.stat*.  Directories that cannot be opened
+are still returned, but are not descended into.
+@function walk
+@string root directory to start from
+@tparam[opt] table opts walk options, with zero or more of the following
+  fields:
+
+ - `follow` boolean, follow symbolic links instead of returning them
+ - `maxdepth` int, do not descend below this many levels under *root*,
+   where `0` returns only *root* itself
+ - `order` string, `"pre"` (default) to return each directory before its
+   contents, or `"post"` to return it after them
+ - `prune` function, called as `prune(path, d_type, stat)` before
+   descending into a directory, which is not entered if it returns true
+ - `stat` boolean, also return a @{posix.sys.stat.PosixStat} per entry
+ - `xdev` boolean, do not descend into directories on other file systems
+@return an iterator returning path, d_type and, with *opts.stat*, a
+  @{posix.sys.stat.PosixStat} table for each entry, starting with *root*
+@usage
+  local dirent = require "posix.dirent"
+  for path, t in dirent.walk("/var/log", {
+    prune = function(path) return path:match "/%.git$" end,
+  }) do
+    if t == dirent.DT_REG then print(path) end
+  end
+*/
+static int
+Pwalk(lua_State *L)
+{
+	const char *root = luaL_checkstring(L, 1);
+	const char *order = "pre";
+	walk_state *w;
+	struct stat st;
+	size_t len;
+
+	checknargs(L, 2);
+	lua_settop(L, 2);
+	w = (walk_state *)lua_newuserdata(L, sizeof *w);
+	memset(w, 0, sizeof *w);
+	if (luaL_newmetatable(L, WALK_HANDLE))
+	{
+		lua_pushcfunction(L, walk_gc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_setmetatable(L, -2);
+
+	w->maxdepth = -1;
+	if (!lua_isnoneornil(L, 2))
+	{
+		luaL_checktype(L, 2, LUA_TTABLE);
+		w->follow = optbooleanfield(L, 2, "follow", 0);
+		w->maxdepth = optintfield(L, 2, "maxdepth", -1);
+		order = optstringfield(L, 2, "order", "pre");
+		w->wantstat = optbooleanfield(L, 2, "stat", 0);
+		w->xdev = optbooleanfield(L, 2, "xdev", 0);
+		lua_getfield(L, 2, "prune");
+		if (!lua_isnil(L, -1))
+		{
+			/* Replace with the type-checked field value. */
+			lua_pop(L, 1);
+			checkfieldtype(L, 2, "prune", LUA_TFUNCTION, NULL);
+		}
+		checkfieldnames(L, 2, Swalk_fields);
+	}
+	else
+		lua_pushnil(L);
+
+	if (STREQ(order, "post"))
+		w->postorder = 1;
+	else if (!STREQ(order, "pre"))
+		luaL_argerror(L, 2, lua_pushfstring(L, "invalid order '%s'", order));
+
+	/* Strip trailing slashes, except from "/" itself. */
+	for (len = strlen(root); len > 1 && root[len - 1] == '/'; len--)
+		;
+	w->path = walk_grow(L, w->path, &w->pathcap, len + 1, 1);
+	memcpy(w->path, root, len);
+	w->path[len] = '\0';
+
+	/* Throw an argument error for consistency with files */
+	if ((w->follow ? stat : lstat)(w->path, &st) == -1)
+	{
+		const char *msg = strerror (errno);
+		msg = lua_pushfstring(L, "%s: %s", root, msg);
+		return luaL_argerror(L, 1, msg);
+	}
+
+	/* upvalues: state userdata, prune function or nil */
+	lua_pushcclosure(L, aux_walk, 2);
 	return 1;
 }
 
@@ -122,10 +527,36 @@ static const luaL_Reg posix_dirent_fns[] =
 {
 	LPOSIX_FUNC( Pdir		),
 	LPOSIX_FUNC( Pfiles		),
+	LPOSIX_FUNC( Pwalk		),
 	{NULL, NULL}
 };
 
 
+/***
+Constants.
+@section constants
+*/
+
+/***
+Directory entry types, as returned by @{walk}.
+@table posix.dirent
+@int DT_BLK block special file
+@int DT_CHR character special file
+@int DT_DIR directory
+@int DT_FIFO named pipe
+@int DT_LNK symbolic link
+@int DT_REG regular file
+@int DT_SOCK socket
+@int DT_UNKNOWN type could not be determined
+@usage
+  -- Print dirent constants supported on this host.
+  for name, value in pairs (require "posix.dirent") do
+    if type (value) == "number" then
+      print (name, value)
+     end
+  end
+*/
+
 LUALIB_API int
 luaopen_posix_dirent(lua_State *L)
 {
@@ -133,5 +564,14 @@ luaopen_posix_dirent(lua_State *L)
 	lua_pushstring(L, LPOSIX_VERSION_STRING("dirent"));
 	lua_setfield(L, -2, "version");
 
+	LPOSIX_CONST( DT_BLK		);
+	LPOSIX_CONST( DT_CHR		);
+	LPOSIX_CONST( DT_DIR		);
+	LPOSIX_CONST( DT_FIFO		);
+	LPOSIX_CONST( DT_LNK		);
+	LPOSIX_CONST( DT_REG		);
+	LPOSIX_CONST( DT_SOCK		);
+	LPOSIX_CONST( DT_UNKNOWN	);
+
 	return 1;
 }
@@ -21,6 +21,9 @@
 #include "_helpers.c"
 
 #include <fcntl.h>
+#if HAVE_FLOCK
+#  include <sys/file.h>
+#endif
 
 
 /* Darwin fails to define O_RSYNC. */
@@ -40,8 +43,9 @@
 
 /***
 Advisory file locks.
-Passed as *arg* to @{fcntl} when *cmd* is `F_GETLK`, `F_SETLK` or `F_SETLKW`.
-@table flock
+Passed as *arg* to @{fcntl} when *cmd* is `F_GETLK`, `F_SETLK`, `F_SETLKW`,
+`F_OFD_GETLK`, `F_OFD_SETLK` or `F_OFD_SETLKW`.
+@table PosixFlock
 @int l_start starting offset
 @int l_len len = 0 means until end of file
 @int l_pid lock owner
@@ -55,9 +59,10 @@ Manipulate file descriptor.
 @function fcntl
 @int fd file descriptor to act on
 @int cmd operation to perform
-@tparam[opt=0] int|flock arg when *cmd* is `F_GETLK`, `F_SETLK` or `F_SETLKW`,
-  then *arg* is a @{flock} table, otherwise an integer with meaning dependent
-  upon the value of *cmd*.
+@tparam[opt=0] int|PosixFlock arg when *cmd* is `F_GETLK`, `F_SETLK`,
+  `F_SETLKW`, or one of their `F_OFD_*` equivalents, then *arg* is a
+  @{PosixFlock} table, otherwise an integer with meaning dependent upon the
+  value of *cmd*.
 @return[1] integer return value depending on *cmd*, if successful
 @return[2] nil
 @treturn[2] string error message
@@ -81,7 +86,14 @@ Pfcntl(lua_State *L)
 		case F_SETLK:
 		case F_SETLKW:
 		case F_GETLK:
+#ifdef F_OFD_SETLK
+		case F_OFD_SETLK:
+		case F_OFD_SETLKW:
+		case F_OFD_GETLK:
+#endif
 			luaL_checktype(L, 3, LUA_TTABLE);
+			/* l_pid must be 0 for open file description locks */
+			memset(&lockinfo, 0, sizeof lockinfo);
 
 			/* Copy fields to flock struct */
 			lua_getfield(L, 3, "l_type");
@@ -118,6 +130,89 @@ Pfcntl(lua_State *L)
 }
 
 
+#if HAVE_FLOCK
+/***
+Apply or remove an advisory lock on a whole file.
+These locks belong to the open file description, so they are shared by
+descriptors duplicated with @{posix.unistd.dup} or inherited across
+@{posix.unistd.fork}, and are released when the last of them is closed.
+They are independent of the byte-range locks taken with @{fcntl} and
+@{lock} on most systems.
+@function flock
+@int fd open file descriptor
+@int operation one of `LOCK_SH`, `LOCK_EX` or `LOCK_UN`, optionally
+  ORed with `LOCK_NB` to fail with `EWOULDBLOCK` instead of waiting
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see flock(2)
+@usage
+  if not P.flock(fd, bor(P.LOCK_EX, P.LOCK_NB)) then
+    error "another instance is already running"
+  end
+*/
+static int
+Pflock(lua_State *L)
+{
+	int fd = checkint(L, 1);
+	int operation = checkint(L, 2);
+	checknargs(L, 2);
+	return pushresult(L, flock(fd, operation), "flock");
+}
+#endif
+
+
+/***
+Apply or remove an advisory lock on a byte range of a file.
+Like @{fcntl} with `F_SETLK` or `F_SETLKW`, but taking plain integers
+rather than a @{PosixFlock} table, for callers that take many locks.
+Where supported, this takes open file description locks (as with
+`F_OFD_SETLK`), which belong to the descriptor returned by @{open}, and
+so are not shared with, or released by, other descriptors for the same
+file in the same process, and are not lost when a forked child closes
+its copy of an inherited descriptor.  Elsewhere, it takes traditional
+process-associated record locks.
+@function lock
+@int fd open file descriptor
+@int type one of `F_RDLCK`, `F_WRLCK` or `F_UNLCK`
+@int[opt=0] start offset of the first byte of the range
+@int[opt=0] len number of bytes in the range, or `0` for through to the
+  end of file, however large it grows
+@bool[opt=false] wait wait for a conflicting lock to be released, rather
+  than failing with `EAGAIN` or `EACCES`
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see fcntl(2)
+@usage
+  -- take an exclusive lock on the 4KiB record for shard n
+  P.lock(fd, P.F_WRLCK, n * 4096, 4096, true)
+  ...
+  P.lock(fd, P.F_UNLCK, n * 4096, 4096)
+*/
+static int
+Plock(lua_State *L)
+{
+	int fd = checkint(L, 1);
+	struct flock lockinfo;
+	int wait;
+	memset(&lockinfo, 0, sizeof lockinfo);
+	lockinfo.l_type = (short)checkint(L, 2);
+	lockinfo.l_whence = SEEK_SET;
+	lockinfo.l_start = (off_t)optinteger(L, 3, 0);
+	lockinfo.l_len = (off_t)optinteger(L, 4, 0);
+	wait = optboolean(L, 5, 0);
+	checknargs(L, 5);
+#ifdef F_OFD_SETLK
+	return pushresult(L, fcntl(fd, wait ? F_OFD_SETLKW : F_OFD_SETLK, &lockinfo), "lock");
+#else
+	return pushresult(L, fcntl(fd, wait ? F_SETLKW : F_SETLK, &lockinfo), "lock");
+#endif
+}
+
+
 /***
 Open a file.
 @function open
@@ -145,6 +240,35 @@ Popen(lua_State *L)
 }
 
 
+
+/***
+Open a file relative to a directory file descriptor.
+@function openat
+@int dirfd directory file descriptor, or `AT_FDCWD`
+@string path relative to *dirfd*, unless absolute
+@int oflags bitwise OR of the flags accepted by @{open} (and `O_DIRECTORY`,
+  `O_NOFOLLOW` and `O_PATH`, where supported)
+@int[opt=511] mode access modes used by `O_CREAT`
+@treturn[1] int file descriptor for *path*, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see openat(2)
+@usage
+local P = require "posix.fcntl"
+local dirfd = P.open ("/etc", bit.bor (P.O_RDONLY, P.O_DIRECTORY))
+local fd = P.openat (dirfd, "passwd", P.O_RDONLY)
+*/
+static int
+Popenat(lua_State *L)
+{
+	int dirfd = checkint(L, 1);
+	const char *path = luaL_checkstring(L, 2);
+	int oflags = checkint(L, 3);
+	checknargs(L, 4);
+	return pushresult(L, openat(dirfd, path, oflags, (mode_t)optinteger(L, 4, 511)), path);
+}
+
 #if HAVE_POSIX_FADVISE
 /***
 Instruct kernel on appropriate cache behaviour for a file or file segment.
@@ -176,12 +300,145 @@ Pposix_fadvise(lua_State *L)
 #endif
 
 
+#if HAVE_POSIX_FALLOCATE
+/***
+Ensure that disk space is allocated for a file region.
+Unlike extending a file with @{posix.unistd.ftruncate}, which leaves a
+sparse hole, the allocated blocks are reserved immediately, so later
+writes into the region cannot fail with `ENOSPC` and do not fragment the
+file.  The file is extended if *offset* + *len* is beyond its end.
+@function posix_fallocate
+@int fd open file descriptor
+@int offset start of region
+@int len number of bytes in region
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see posix_fallocate(3)
+@usage
+  -- preallocate a 64MiB write-ahead log segment
+  P.posix_fallocate(fd, 0, 64 * 1024 * 1024)
+*/
+static int
+Pposix_fallocate(lua_State *L)
+{
+	int fd       = checkint(L, 1);
+	off_t offset = (off_t)checkinteger(L, 2);
+	off_t len    = (off_t)checkinteger(L, 3);
+	int r;
+	checknargs(L, 3);
+	r = posix_fallocate(fd, offset, len);
+	if (r != 0)
+	{
+		errno = r;
+		return pusherror(L, "posix_fallocate");
+	}
+	return pushintegerresult(0);
+}
+#endif
+
+
+#if HAVE_FALLOCATE
+/***
+Manipulate the allocated disk space for a file region.
+With *mode* `0`, behaves like @{posix_fallocate}, but fails rather than
+falling back to writing zeros when the filesystem cannot allocate space
+directly.  Otherwise *mode* selects one of the Linux-specific operations:
+`FALLOC_FL_KEEP_SIZE` preallocates without changing the file size;
+`FALLOC_FL_PUNCH_HOLE` (which must be ORed with `FALLOC_FL_KEEP_SIZE`)
+deallocates the region, leaving a hole that reads as zeros;
+`FALLOC_FL_COLLAPSE_RANGE` removes the region and shifts the remainder
+of the file down; `FALLOC_FL_ZERO_RANGE` zeros the region, converting
+it to unwritten extents where possible; and `FALLOC_FL_INSERT_RANGE`
+inserts a hole, shifting the remainder of the file up.  Collapsing and
+inserting require *offset* and *len* to be multiples of the filesystem
+block size.
+@function fallocate
+@int fd open file descriptor
+@int mode `0`, or a bitwise OR of `FALLOC_FL_*` flags
+@int offset start of region
+@int len number of bytes in region
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see fallocate(2)
+@usage
+  -- discard the first 1MiB of a log segment, keeping offsets intact
+  P.fallocate(fd, bor(P.FALLOC_FL_PUNCH_HOLE, P.FALLOC_FL_KEEP_SIZE),
+    0, 1024 * 1024)
+*/
+static int
+Pfallocate(lua_State *L)
+{
+	int fd       = checkint(L, 1);
+	int mode     = checkint(L, 2);
+	off_t offset = (off_t)checkinteger(L, 3);
+	off_t len    = (off_t)checkinteger(L, 4);
+	checknargs(L, 4);
+	return pushresult(L, fallocate(fd, mode, offset, len), "fallocate");
+}
+#endif
+
+
+#if HAVE_SYNC_FILE_RANGE
+/***
+Start or wait for writeback of a file region.
+With `SYNC_FILE_RANGE_WRITE` alone, this starts writeback of the dirty
+pages in the region and returns without waiting, so that a later
+@{posix.unistd.fdatasync} has less to do.  Adding
+`SYNC_FILE_RANGE_WAIT_BEFORE` and `SYNC_FILE_RANGE_WAIT_AFTER` also
+waits for writeback to complete.  This flushes no metadata and no disk
+write cache, so it does not make data durable on its own.
+@function sync_file_range
+@int fd open file descriptor
+@int offset start of region
+@int nbytes number of bytes in region, or `0` for through to the end of file
+@int flags bitwise OR of zero or more of `SYNC_FILE_RANGE_WAIT_BEFORE`,
+  `SYNC_FILE_RANGE_WRITE` and `SYNC_FILE_RANGE_WAIT_AFTER`
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see sync_file_range(2)
+@usage
+  -- start writeback of the batch just appended, then carry on
+  P.sync_file_range(fd, batchstart, batchlen, P.SYNC_FILE_RANGE_WRITE)
+*/
+static int
+Psync_file_range(lua_State *L)
+{
+	int fd         = checkint(L, 1);
+	off_t offset   = (off_t)checkinteger(L, 2);
+	off_t nbytes   = (off_t)checkinteger(L, 3);
+	unsigned flags = (unsigned)checkinteger(L, 4);
+	checknargs(L, 4);
+	return pushresult(L, sync_file_range(fd, offset, nbytes, flags), "sync_file_range");
+}
+#endif
+
+
 static const luaL_Reg posix_fcntl_fns[] =
 {
+#if HAVE_FALLOCATE
+	LPOSIX_FUNC( Pfallocate		),
+#endif
 	LPOSIX_FUNC( Pfcntl		),
+#if HAVE_FLOCK
+	LPOSIX_FUNC( Pflock		),
+#endif
+	LPOSIX_FUNC( Plock		),
 	LPOSIX_FUNC( Popen		),
+	LPOSIX_FUNC( Popenat		),
 #if HAVE_POSIX_FADVISE
 	LPOSIX_FUNC( Pposix_fadvise	),
+#endif
+#if HAVE_POSIX_FALLOCATE
+	LPOSIX_FUNC( Pposix_fallocate	),
+#endif
+#if HAVE_SYNC_FILE_RANGE
+	LPOSIX_FUNC( Psync_file_range	),
 #endif
 	{NULL, NULL}
 };
@@ -202,6 +459,11 @@ if they are usually bitwise ORed with other values, otherwise `nil`.
 @int AT_REMOVEDIR remove directory instead of unlinking file
 @int AT_SYMLINK_FOLLOW follow symbolic links
 @int AT_SYMLINK_NOFOLLOW do not follow symbolic links
+@int FALLOC_FL_COLLAPSE_RANGE remove a region and close the gap
+@int FALLOC_FL_INSERT_RANGE insert a hole and shift following data up
+@int FALLOC_FL_KEEP_SIZE allocate space without changing the file size
+@int FALLOC_FL_PUNCH_HOLE deallocate a region, leaving a hole
+@int FALLOC_FL_ZERO_RANGE zero a region without writing data
 @int FD_CLOEXEC close file descriptor on exec flag
 @int F_DUPFD duplicate file descriptor
 @int F_GETFD get file descriptor flags
@@ -211,21 +473,35 @@ if they are usually bitwise ORed with other values, otherwise `nil`.
 @int F_GETLK get record locking information
 @int F_SETLK set record locking information
 @int F_SETLKW set lock, and wait if blocked
+@int F_OFD_GETLK get open file description locking information
+@int F_OFD_SETLK set open file description lock
+@int F_OFD_SETLKW set open file description lock, and wait if blocked
 @int F_GETOWN get SIGIO/SIGURG process owner
 @int F_SETOWN set SIGIO/SIGURG process owner
+@int F_GETPIPE_SZ get pipe capacity in bytes
+@int F_SETPIPE_SZ set pipe capacity to at least *arg* bytes
 @int F_RDLCK shared or read lock
 @int F_WRLCK exclusive or write lock
 @int F_UNLCK unlock
+@int LOCK_EX exclusive @{flock}
+@int LOCK_NB do not block when locking with @{flock}
+@int LOCK_SH shared @{flock}
+@int LOCK_UN remove an existing @{flock}
 @int O_RDONLY open for reading only
 @int O_WRONLY open for writing only
 @int O_RDWR open for reading and writing
 @int O_APPEND set append mode
 @int O_CLOEXEC set FD_CLOEXEC atomically
 @int O_CREAT create if nonexistent
+@int O_DIRECT minimise caching for files, or packet mode for
+  @{posix.unistd.pipe2}
+@int O_DIRECTORY fail unless path is a directory
 @int O_DSYNC synchronise io data integrity
 @int O_EXCL error if file already exists
 @int O_NOCTTY don't assign controlling terminal
+@int O_NOFOLLOW fail if path is a symbolic link
 @int O_NONBLOCK no delay
+@int O_PATH obtain a descriptor for *at functions only, without opening the file
 @int O_RSYNC synchronise file read integrity
 @int O_SYNC synchronise file write integrity
 @int O_TRUNC truncate to zero length
@@ -235,6 +511,9 @@ if they are usually bitwise ORed with other values, otherwise `nil`.
 @int POSIX_FADV_NOREUSE expecting to access data once only
 @int POSIX_FADV_WILLNEED expecting to access data in the near future
 @int POSIX_FADV_DONTNEED not expecting to access the data in the near future
+@int SYNC_FILE_RANGE_WAIT_AFTER wait for writeback to complete
+@int SYNC_FILE_RANGE_WAIT_BEFORE wait for writeback already in progress
+@int SYNC_FILE_RANGE_WRITE start writeback of dirty pages
 @usage
   -- Print fcntl constants supported on this host.
   for name, value in pairs (require "posix.fcntl") do
@@ -275,6 +554,23 @@ luaopen_posix_fcntl(lua_State *L)
 	LPOSIX_CONST( AT_NO_AUTOMOUNT	);
 #endif
 
+	/* fallocate modes */
+#ifdef FALLOC_FL_COLLAPSE_RANGE
+	LPOSIX_CONST( FALLOC_FL_COLLAPSE_RANGE	);
+#endif
+#ifdef FALLOC_FL_INSERT_RANGE
+	LPOSIX_CONST( FALLOC_FL_INSERT_RANGE	);
+#endif
+#ifdef FALLOC_FL_KEEP_SIZE
+	LPOSIX_CONST( FALLOC_FL_KEEP_SIZE	);
+#endif
+#ifdef FALLOC_FL_PUNCH_HOLE
+	LPOSIX_CONST( FALLOC_FL_PUNCH_HOLE	);
+#endif
+#ifdef FALLOC_FL_ZERO_RANGE
+	LPOSIX_CONST( FALLOC_FL_ZERO_RANGE	);
+#endif
+
 	/* fcntl flags */
 	LPOSIX_CONST( FD_CLOEXEC	);
 	LPOSIX_CONST( F_DUPFD		);
@@ -291,6 +587,27 @@ luaopen_posix_fcntl(lua_State *L)
 	LPOSIX_CONST( F_WRLCK		);
 	LPOSIX_CONST( F_UNLCK		);
 
+	/* Linux 3.15 and above */
+#ifdef F_OFD_SETLK
+	LPOSIX_CONST( F_OFD_GETLK	);
+	LPOSIX_CONST( F_OFD_SETLK	);
+	LPOSIX_CONST( F_OFD_SETLKW	);
+#endif
+
+	/* Linux 2.6.35 and above */
+#ifdef F_SETPIPE_SZ
+	LPOSIX_CONST( F_GETPIPE_SZ	);
+	LPOSIX_CONST( F_SETPIPE_SZ	);
+#endif
+
+	/* flock operations */
+#if HAVE_FLOCK
+	LPOSIX_CONST( LOCK_EX		);
+	LPOSIX_CONST( LOCK_NB		);
+	LPOSIX_CONST( LOCK_SH		);
+	LPOSIX_CONST( LOCK_UN		);
+#endif
+
 	/* file creation & status flags */
 	LPOSIX_CONST( O_RDONLY		);
 	LPOSIX_CONST( O_WRONLY		);
@@ -305,6 +622,20 @@ luaopen_posix_fcntl(lua_State *L)
 	LPOSIX_CONST( O_SYNC		);
 	LPOSIX_CONST( O_TRUNC		);
 	LPOSIX_CONST( O_CLOEXEC		);
+#ifdef O_DIRECT
+	LPOSIX_CONST( O_DIRECT		);
+#endif
+#ifdef O_DIRECTORY
+	LPOSIX_CONST( O_DIRECTORY	);
+#endif
+#ifdef O_NOFOLLOW
+	LPOSIX_CONST( O_NOFOLLOW	);
+#endif
+
+	/* Linux 2.6.39 and above */
+#ifdef O_PATH
+	LPOSIX_CONST( O_PATH		);
+#endif
 
 	/* Linux 3.11 and above */
 #ifdef O_TMPFILE
@@ -331,5 +662,16 @@ luaopen_posix_fcntl(lua_State *L)
 	LPOSIX_CONST( POSIX_FADV_DONTNEED	);
 #endif
 
+	/* sync_file_range flags */
+#ifdef SYNC_FILE_RANGE_WAIT_AFTER
+	LPOSIX_CONST( SYNC_FILE_RANGE_WAIT_AFTER	);
+#endif
+#ifdef SYNC_FILE_RANGE_WAIT_BEFORE
+	LPOSIX_CONST( SYNC_FILE_RANGE_WAIT_BEFORE	);
+#endif
+#ifdef SYNC_FILE_RANGE_WRITE
+	LPOSIX_CONST( SYNC_FILE_RANGE_WRITE	);
+#endif
+
 	return 1;
 }
@@ -13,7 +13,8 @@
  Filename matching.
 
  Functions and constants for matching known filenames against shell-style
- pattern strings.
+ pattern strings, and matchers that test many names against a set of
+ patterns compiled in advance.
 
 @see posix.glob
 @module posix.fnmatch
@@ -47,8 +48,369 @@ Pfnmatch(lua_State *L)
 }
 
 
+#define FNM_MATCHER	PACKAGE " fnmatch matcher"
+#define FNM_NOKEY	256	/* bucket of patterns without a literal prefix */
+
+/* A compiled pattern.  Most names can be rejected by comparing the
+   literal text before the first and after the last wildcard, without
+   calling fnmatch at all.  A pattern that is just prefix*suffix needs
+   no fnmatch call even when the prefilter passes. */
+typedef struct
+{
+	const char	*pat;
+	size_t		prelen, suflen;
+	int		index;		/* position in the original list */
+	int		key;		/* first byte of prefix, or FNM_NOKEY */
+	int		onestar;
+} fnm_pat;
+
+typedef struct
+{
+	fnm_pat		*pats;
+	size_t		npats, patcap;
+	size_t		bucket[FNM_NOKEY + 2];	/* start of each key's run */
+	int		flags;
+	int		prefilter;
+} fnm_matcher;
+
+
+static int
+fnm_cmp(const void *a, const void *b)
+{
+	const fnm_pat *x = a, *y = b;
+	if (x->key != y->key)
+		return x->key - y->key;
+	return x->index - y->index;
+}
+
+
+static int
+fnm_gc(lua_State *L)
+{
+	fnm_matcher *m = (fnm_matcher *)lua_touserdata(L, 1);
+	void *ud;
+	lua_Alloc lalloc = lua_getallocf(L, &ud);
+	if (m->pats != NULL)
+		lalloc(ud, m->pats, m->patcap * sizeof *m->pats, 0);
+	m->pats = NULL;
+	m->npats = m->patcap = 0;
+	return 0;
+}
+
+
+/* Fill in p from pattern string pat, returning 1 if pat has no
+   wildcards at all. */
+static int
+fnm_compile(fnm_matcher *m, fnm_pat *p, const char *pat, size_t len)
+{
+	int noescape = (m->flags & FNM_NOESCAPE) != 0;
+	const char *magic = noescape ? "*?[]" : "*?[]\\";
+	size_t i, nstars = 0, nmagic = 0;
+
+	p->pat = pat;
+	p->prelen = strcspn(pat, magic);
+	for (i = len; i > p->prelen && !strchr(magic, pat[i - 1]); i--)
+		;
+	p->suflen = len - i;
+	for (i = 0; i < len; i++)
+		if (strchr(magic, pat[i]))
+		{
+			nmagic++;
+			nstars += pat[i] == '*';
+		}
+	p->onestar = nmagic == 1 && nstars == 1;
+	p->key = m->prefilter && p->prelen > 0 ? (unsigned char)pat[0] : FNM_NOKEY;
+	return m->prefilter && strcspn(pat, noescape ? "*?[" : "*?[\\") == len;
+}
+
+
+static int
+fnm_test(fnm_matcher *m, fnm_pat *p, const char *s, size_t len)
+{
+	if (m->prefilter)
+	{
+		const char *mid;
+		if (len < p->prelen + p->suflen
+		    || memcmp(s, p->pat, p->prelen) != 0
+		    || memcmp(s + len - p->suflen, p->pat + strlen(p->pat) - p->suflen, p->suflen) != 0)
+			return 0;
+		if (!p->onestar)
+			return fnmatch(p->pat, s, m->flags) == 0;
+
+		/* prefix*suffix: only the text matched by the star remains. */
+		mid = s + p->prelen;
+		if ((m->flags & FNM_PATHNAME)
+		    && memchr(mid, '/', len - p->prelen - p->suflen) != NULL)
+			return 0;
+		/* A leading period must match a period in the pattern, not the
+		   star, even if the star matches nothing. */
+		if ((m->flags & FNM_PERIOD) && *mid == '.'
+		    && (p->prelen == 0 || ((m->flags & FNM_PATHNAME) && mid[-1] == '/')))
+			return 0;
+		return 1;
+	}
+	return fnmatch(p->pat, s, m->flags) == 0;
+}
+
+
+/* Index of the first pattern matching s, or 0.  Literal patterns are
+   looked up in the table at index lits; the rest are scanned in the
+   bucket for the first byte of s, and the bucket for patterns without
+   a literal prefix, in order of their original position. */
+static int
+fnm_match(lua_State *L, fnm_matcher *m, int lits, const char *s, size_t len)
+{
+	int best = 0;
+	size_t i, iend, j, jend;
+
+	lua_pushlstring(L, s, len);
+	lua_rawget(L, lits);
+	if (lua_isnumber(L, -1))
+		best = (int)lua_tointeger(L, -1);
+	lua_pop(L, 1);
+
+	i = iend = 0;
+	if (len > 0)
+	{
+		i = m->bucket[(unsigned char)s[0]];
+		iend = m->bucket[(unsigned char)s[0] + 1];
+	}
+	j = m->bucket[FNM_NOKEY];
+	jend = m->bucket[FNM_NOKEY + 1];
+	while (i < iend || j < jend)
+	{
+		fnm_pat *p;
+		if (j >= jend || (i < iend && m->pats[i].index < m->pats[j].index))
+			p = &m->pats[i++];
+		else
+			p = &m->pats[j++];
+		if (best && p->index > best)
+			break;
+		if (fnm_test(m, p, s, len))
+			return p->index;
+	}
+	return best;
+}
+
+
+static fnm_matcher *
+checkmatcher(lua_State *L, int narg)
+{
+	return (fnm_matcher *)luaL_checkudata(L, narg, FNM_MATCHER);
+}
+
+
+/***
+Matcher Methods.
+@section methods
+*/
+
+
+/***
+Match a filename against the compiled patterns.
+@function match
+@string name filename
+@treturn[1] int position of the first pattern in the list passed to
+  @{compile} that matches *name*, if any
+@return[2] nil if no pattern matches
+@usage
+  if excludes:match(path) then return end
+*/
+static int
+fnm_matchmethod(lua_State *L)
+{
+	fnm_matcher *m = checkmatcher(L, 1);
+	size_t len;
+	const char *s = luaL_checklstring(L, 2, &len);
+	int r;
+	checknargs(L, 2);
+	lua_getuservalue(L, 1);
+	lua_rawgeti(L, -1, 2);
+	r = fnm_match(L, m, lua_gettop(L), s, len);
+	if (r == 0)
+		return lua_pushnil(L), 1;
+	return pushintegerresult(r);
+}
+
+
+/***
+Select the filenames in a list that match the compiled patterns.
+@function filter
+@tparam table names list of filenames
+@bool[opt=false] invert select the names that do not match instead
+@treturn table list of selected names, in their original order
+@usage
+  local sources = fnmatch.compile {"*.c", "*.h"}:filter(names)
+*/
+static int
+fnm_filter(lua_State *L)
+{
+	fnm_matcher *m = checkmatcher(L, 1);
+	int invert = optboolean(L, 3, 0);
+	int lits, i, n, count = 0;
+	luaL_checktype(L, 2, LUA_TTABLE);
+	checknargs(L, 3);
+
+	lua_getuservalue(L, 1);
+	lua_rawgeti(L, -1, 2);
+	lits = lua_gettop(L);
+	n = (int)lua_rawlen(L, 2);
+	lua_createtable(L, n, 0);
+	for (i = 1; i <= n; i++)
+	{
+		size_t len;
+		const char *s;
+		lua_rawgeti(L, 2, i);
+		if (lua_type(L, -1) != LUA_TSTRING)
+			return luaL_argerror(L, 2, lua_pushfstring(L,
+				"string expected at index %d, got %s", i, luaL_typename(L, -1)));
+		s = lua_tolstring(L, -1, &len);
+		if ((fnm_match(L, m, lits, s, len) != 0) != invert)
+			lua_rawseti(L, -2, ++count);
+		else
+			lua_pop(L, 1);
+	}
+	return 1;
+}
+
+
+static const luaL_Reg fnm_methods[] =
+{
+	{"filter",	fnm_filter},
+	{"match",	fnm_matchmethod},
+	{NULL, NULL}
+};
+
+
+/***
+Functions.
+@section functions
+*/
+
+
+/***
+Compile a set of shell patterns for repeated matching.
+Patterns without wildcards are merged into a single hash lookup, and
+the rest are indexed by their first literal character, so that each
+name is only tested against patterns that could possibly match it.
+The literal text before the first and after the last wildcard of each
+pattern is compared before falling back to `fnmatch`, which is not
+called at all for simple patterns like `*.o` or `lib*`.
+@function compile
+@tparam string|table patterns a shell pattern, or a list of them
+@int[opt=0] flags passed to `fnmatch` for every pattern
+@return a matcher, with methods @{match} and @{filter}
+@see fnmatch
+@usage
+  local fnmatch = require "posix.fnmatch"
+  local ignore = fnmatch.compile({"*.o", "*~", ".git", "build"},
+    fnmatch.FNM_PATHNAME)
+  for _, path in ipairs(ignore:filter(paths, true)) do print(path) end
+*/
+static int
+Pcompile(lua_State *L)
+{
+	int flags = optint(L, 2, 0);
+	int i, n, uv, pats, lits;
+	fnm_matcher *m;
+	size_t k;
+	void *ud;
+	lua_Alloc lalloc = lua_getallocf(L, &ud);
+	checknargs(L, 2);
+
+	/* Uservalue is {patterns, literals}, keeping the strings alive. */
+	lua_createtable(L, 2, 0);
+	uv = lua_gettop(L);
+	if (lua_type(L, 1) == LUA_TSTRING)
+	{
+		lua_createtable(L, 1, 0);
+		lua_pushvalue(L, 1);
+		lua_rawseti(L, -2, 1);
+	}
+	else
+	{
+		luaL_argcheck(L, lua_type(L, 1) == LUA_TTABLE, 1,
+			lua_pushfstring(L, "string or table expected, got %s", luaL_typename(L, 1)));
+		/* Copy, so that later changes to the caller's table cannot
+		   free strings that the compiled patterns point into. */
+		n = (int)lua_rawlen(L, 1);
+		lua_createtable(L, n, 0);
+		for (i = 1; i <= n; i++)
+		{
+			lua_rawgeti(L, 1, i);
+			if (lua_type(L, -1) != LUA_TSTRING)
+				return luaL_argerror(L, 1, lua_pushfstring(L,
+					"string expected at index %d, got %s", i, luaL_typename(L, -1)));
+			lua_rawseti(L, -2, i);
+		}
+	}
+	pats = lua_gettop(L);
+	n = (int)lua_rawlen(L, pats);
+	lua_newtable(L);
+	lits = lua_gettop(L);
+	lua_pushvalue(L, pats);
+	lua_rawseti(L, uv, 1);
+	lua_pushvalue(L, lits);
+	lua_rawseti(L, uv, 2);
+
+	m = (fnm_matcher *)lua_newuserdata(L, sizeof *m);
+	memset(m, 0, sizeof *m);
+	m->flags = flags;
+	/* Prefilters compare bytes exactly, so only apply them for flags
+	   whose effect fnm_test understands. */
+	m->prefilter = (flags & ~(FNM_PATHNAME | FNM_PERIOD | FNM_NOESCAPE)) == 0;
+	if (luaL_newmetatable(L, FNM_MATCHER))
+	{
+		luaL_newlib(L, fnm_methods);
+		lua_setfield(L, -2, "__index");
+		lua_pushcfunction(L, fnm_gc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_setmetatable(L, -2);
+	lua_pushvalue(L, uv);
+	lua_setuservalue(L, -2);
+
+	if (n > 0 && (m->pats = lalloc(ud, NULL, 0, n * sizeof *m->pats)) == NULL)
+		return luaL_error(L, "not enough memory");
+	m->patcap = n;
+	for (i = 1; i <= n; i++)
+	{
+		size_t len;
+		const char *pat;
+		lua_rawgeti(L, pats, i);
+		pat = lua_tolstring(L, -1, &len);
+		m->pats[m->npats].index = i;
+		if (!fnm_compile(m, &m->pats[m->npats], pat, len))
+			m->npats++;
+		else
+		{
+			/* Keep the first position of a repeated literal. */
+			lua_pushvalue(L, -1);
+			lua_rawget(L, lits);
+			if (lua_isnil(L, -1))
+			{
+				lua_pushvalue(L, -2);
+				lua_pushinteger(L, i);
+				lua_rawset(L, lits);
+			}
+			lua_pop(L, 1);
+		}
+		lua_pop(L, 1);
+	}
+
+	qsort(m->pats, m->npats, sizeof *m->pats, fnm_cmp);
+	for (k = 0, i = 0; i <= FNM_NOKEY + 1; i++)
+	{
+		while (k < m->npats && m->pats[k].key < i)
+			k++;
+		m->bucket[i] = k;
+	}
+	return 1;
+}
+
 static const luaL_Reg posix_fnmatch_fns[] =
 {
+	LPOSIX_FUNC( Pcompile		),
 	LPOSIX_FUNC( Pfnmatch		),
 	{NULL, NULL}
 };
@@ -0,0 +1,970 @@
+/*
+ * POSIX library for Lua 5.1, 5.2, 5.3 & 5.4.
+ * Copyright (C) 2013-2025 Gary V. Vaughan
+ * Copyright (C) 2010-2013 Reuben Thomas <rrt@sc3d.org>
+ * Copyright (C) 2008-2010 Natanael Copa <natanael.copa@gmail.com>
+ * Clean up and bug fixes by Leo Razoumov <slonik.az@gmail.com> 2006-10-11
+ * Luiz Henrique de Figueiredo <lhf@tecgraf.puc-rio.br> 07 Apr 2006 23:17:49
+ * Based on original by Claudio Terra for Lua 3.x.
+ * With contributions by Roberto Ierusalimschy.
+ * With documentation from Steve Donovan 2012
+ */
+/***
+ Parallel Directory Tree Operations.
+
+ Copy or remove a whole directory tree using a bounded pool of worker
+ threads, so that the metadata operations on many directories are in
+ flight at once.  This matters most on networked file systems, where
+ each `unlink`, `mkdir` or `open` costs a round trip to the server.
+
+ Each operation runs in the background, and returns immediately with
+ an operation object.  Its @{fileno} descriptor becomes readable as
+ work completes, so progress can be watched with @{posix.poll.poll}
+ alongside other descriptors, and @{wait} collects the final result.
+ Worker threads never touch the Lua state.
+
+ Where the underlying system has no thread support, this module
+ loads, but `posix.fsops.copytree` and `posix.fsops.rmtree` are `nil`.
+
+@module posix.fsops
+*/
+
+#include "_helpers.c"
+
+#if HAVE_PTHREAD_H
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/stat.h>
+
+
+#define FSO_HANDLE		PACKAGE " fsops operation"
+#define FSO_MAX_THREADS		64
+#define FSO_BUFSIZ		65536
+
+enum { FSO_RMDIR, FSO_UNLINK, FSO_CPDIR, FSO_CPFILE, FSO_CPOTHER };
+
+/* One unit of work.  Directory nodes stay allocated until all of their
+   children have finished, counted by pending, so that the directory
+   itself can be removed, or have its times set, last.  Until then they
+   also keep their directories open, and children are opened relative to
+   those with the *at functions, so that no path is resolved from the
+   start again, and a directory renamed mid-walk cannot redirect it. */
+typedef struct fso_node
+{
+	struct fso_node	*parent;
+	struct fso_node	*next;		/* queue link */
+	int		kind;
+	int		pending;	/* unfinished children + 1 */
+	int		failed;		/* a child could not be removed */
+	struct stat	st;		/* source status, when copying */
+	DIR		*dir;		/* open source directory */
+	int		dstfd;		/* open destination directory */
+	char		*src;		/* full paths, for error messages */
+	char		*dst;
+	const char	*srcname;	/* relative to the parent's directories */
+	const char	*dstname;
+} fso_node;
+
+/* Directory descriptors that node's srcname and dstname are relative to. */
+#define fso_srcat(node)	((node)->parent ? dirfd((node)->parent->dir) : AT_FDCWD)
+#define fso_dstat(node)	((node)->parent ? (node)->parent->dstfd : AT_FDCWD)
+
+typedef struct
+{
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	fso_node	*queue;
+	size_t		outstanding;	/* queued or running tasks */
+	volatile int	cancelled;
+	int		skipped;	/* some work was cancelled */
+	int		finished;
+	int		preserve;
+	pthread_t	threads[FSO_MAX_THREADS];
+	int		nthreads;
+	int		fd[2];		/* progress pipe */
+	lua_Integer	done, failed;
+	int		err;
+	char		*errpath;
+} fso_op;
+
+
+static char *
+fso_join(const char *dir, const char *name)
+{
+	size_t dlen, nlen;
+	char *r;
+	if (dir == NULL)
+		return NULL;
+	dlen = strlen(dir);
+	nlen = strlen(name);
+	if ((r = malloc(dlen + nlen + 2)) == NULL)
+		return NULL;
+	memcpy(r, dir, dlen);
+	r[dlen] = '/';
+	memcpy(r + dlen + 1, name, nlen + 1);
+	return r;
+}
+
+
+static fso_node *
+fso_newnode(int kind, fso_node *parent, const char *src, const char *dst)
+{
+	fso_node *node = calloc(1, sizeof *node);
+	if (node == NULL)
+		return NULL;
+	node->kind = kind;
+	node->pending = 1;
+	node->parent = parent;
+	node->dstfd = -1;
+	node->src = src ? strdup(src) : NULL;
+	node->dst = dst ? strdup(dst) : NULL;
+	if ((src && !node->src) || (dst && !node->dst))
+	{
+		free(node->src);
+		free(node->dst);
+		free(node);
+		return NULL;
+	}
+	/* A child's paths are its parent's joined with its own name. */
+	node->srcname = node->src && parent ? node->src + strlen(parent->src) + 1 : node->src;
+	node->dstname = node->dst && parent ? node->dst + strlen(parent->dst) + 1 : node->dst;
+	return node;
+}
+
+
+static void
+fso_freenode(fso_node *node)
+{
+	if (node->dir != NULL)
+		closedir(node->dir);
+	if (node->dstfd != -1)
+		close(node->dstfd);
+	free(node->src);
+	free(node->dst);
+	free(node);
+}
+
+
+/* Wake anyone polling the progress descriptor.  A full pipe is already
+   readable, so a failed write loses nothing. */
+static void
+fso_notify(fso_op *op)
+{
+	ssize_t r = write(op->fd[1], "", 1);
+	(void)r;
+}
+
+
+static void
+fso_did(fso_op *op)
+{
+	pthread_mutex_lock(&op->lock);
+	op->done++;
+	pthread_mutex_unlock(&op->lock);
+}
+
+
+/* Mark node failed; its children may be doing the same concurrently. */
+static void
+fso_markfailed(fso_op *op, fso_node *node)
+{
+	pthread_mutex_lock(&op->lock);
+	node->failed = 1;
+	pthread_mutex_unlock(&op->lock);
+}
+
+
+/* Count a failure, remembering the first one for wait(). */
+static void
+fso_fail(fso_op *op, const char *path, int err)
+{
+	pthread_mutex_lock(&op->lock);
+	op->failed++;
+	if (op->err == 0)
+	{
+		op->err = err;
+		op->errpath = path ? strdup(path) : NULL;
+	}
+	pthread_mutex_unlock(&op->lock);
+}
+
+
+static void
+fso_enqueue(fso_op *op, fso_node *node)
+{
+	pthread_mutex_lock(&op->lock);
+	if (node->parent)
+		node->parent->pending++;
+	node->next = op->queue;
+	op->queue = node;
+	op->outstanding++;
+	pthread_cond_signal(&op->cond);
+	pthread_mutex_unlock(&op->lock);
+}
+
+
+/* Check for cancellation, noting whether it left any work undone. */
+static int
+fso_cancelled(fso_op *op)
+{
+	if (!op->cancelled)
+		return 0;
+	pthread_mutex_lock(&op->lock);
+	op->skipped = 1;
+	pthread_mutex_unlock(&op->lock);
+	return 1;
+}
+
+
+/* Copy the times in st to name in directory fd, or to fd itself if
+   name is NULL. */
+static void
+fso_settimes(int fd, const char *name, struct stat *st)
+{
+	struct timespec times[2];
+#if defined __APPLE__
+	times[0] = st->st_atimespec;
+	times[1] = st->st_mtimespec;
+#else
+	times[0] = st->st_atim;
+	times[1] = st->st_mtim;
+#endif
+	if (name == NULL)
+		futimens(fd, times);
+	else
+		utimensat(fd, name, times, AT_SYMLINK_NOFOLLOW);
+}
+
+
+/* Run once every child of a directory node has finished. */
+static void
+fso_complete(fso_op *op, fso_node *node)
+{
+	if (fso_cancelled(op))
+		return;
+	switch (node->kind)
+	{
+		case FSO_RMDIR:
+			if (node->failed)
+				break;
+			if (node->dir != NULL)
+			{
+				closedir(node->dir);
+				node->dir = NULL;
+			}
+			if (unlinkat(fso_srcat(node), node->srcname, AT_REMOVEDIR) == -1)
+			{
+				fso_fail(op, node->src, errno);
+				fso_markfailed(op, node);
+			}
+			else
+				fso_did(op);
+			break;
+		case FSO_CPDIR:
+			if (op->preserve && !node->failed && node->dstfd != -1)
+			{
+				fchmod(node->dstfd, node->st.st_mode & 07777);
+				fso_settimes(node->dstfd, NULL, &node->st);
+			}
+			break;
+	}
+}
+
+
+/* Drop one reference to node, completing and freeing it, and then its
+   ancestors in turn, as their last references go. */
+static void
+fso_release(fso_op *op, fso_node *node)
+{
+	while (node != NULL)
+	{
+		fso_node *parent = node->parent;
+		int pending;
+
+		pthread_mutex_lock(&op->lock);
+		pending = --node->pending;
+		pthread_mutex_unlock(&op->lock);
+		if (pending > 0)
+			return;
+
+		fso_complete(op, node);
+		if (parent && node->failed && parent->kind == FSO_RMDIR)
+			fso_markfailed(op, parent);
+		fso_freenode(node);
+		node = parent;
+	}
+}
+
+
+/* Open node's source directory relative to its parent's, keeping it
+   open for node's children until node is freed. */
+static DIR *
+fso_opendir(fso_op *op, fso_node *node)
+{
+	int fd = openat(fso_srcat(node), node->srcname,
+		O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd == -1 || (node->dir = fdopendir(fd)) == NULL)
+	{
+		fso_fail(op, node->src, errno);
+		if (fd != -1)
+			close(fd);
+		fso_markfailed(op, node);
+		return NULL;
+	}
+	return node->dir;
+}
+
+
+/* Remove every entry of a directory, handing subdirectories back to the
+   pool.  Unlinking first and only checking the type when that fails
+   saves a stat for every plain file. */
+static void
+fso_rmdir(fso_op *op, fso_node *node)
+{
+	struct dirent *e;
+	DIR *dir = fso_opendir(op, node);
+	int fd;
+	if (dir == NULL)
+		return;
+	fd = dirfd(dir);
+
+	while (!fso_cancelled(op) && (e = readdir(dir)) != NULL)
+	{
+		struct stat st;
+		fso_node *child;
+		char *path;
+
+		if (STREQ(e->d_name, ".") || STREQ(e->d_name, ".."))
+			continue;
+		if (unlinkat(fd, e->d_name, 0) == 0)
+		{
+			fso_did(op);
+			continue;
+		}
+		if ((errno == EISDIR || errno == EPERM)
+		    && fstatat(fd, e->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0
+		    && S_ISDIR(st.st_mode))
+		{
+			path = fso_join(node->src, e->d_name);
+			child = path ? fso_newnode(FSO_RMDIR, node, path, NULL) : NULL;
+			free(path);
+			if (child != NULL)
+			{
+				fso_enqueue(op, child);
+				continue;
+			}
+			errno = ENOMEM;
+		}
+		path = fso_join(node->src, e->d_name);
+		fso_fail(op, path ? path : node->src, errno);
+		free(path);
+		fso_markfailed(op, node);
+	}
+}
+
+
+static int
+fso_copydata(int in, int out)
+{
+	char buf[FSO_BUFSIZ];
+	ssize_t n;
+
+#if HAVE_COPY_FILE_RANGE
+	/* Let the kernel, or a server side copy, move the data where it
+	   can; both descriptors' offsets advance, so any fallback carries
+	   on from wherever this stops. */
+	while ((n = copy_file_range(in, NULL, out, NULL, 1 << 30, 0)) > 0)
+		;
+	if (n == 0)
+		return 0;
+	if (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP)
+		return -1;
+#endif
+
+	while ((n = read(in, buf, sizeof buf)) != 0)
+	{
+		char *p = buf;
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		while (n > 0)
+		{
+			ssize_t w = write(out, p, n);
+			if (w == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				return -1;
+			}
+			p += w;
+			n -= w;
+		}
+	}
+	return 0;
+}
+
+
+static void
+fso_cpfile(fso_op *op, fso_node *node)
+{
+	mode_t mode = op->preserve ? (node->st.st_mode & 0777) : 0666;
+	int in, out;
+
+	if ((in = openat(fso_srcat(node), node->srcname,
+			O_RDONLY | O_NOFOLLOW | O_CLOEXEC)) == -1)
+	{
+		fso_fail(op, node->src, errno);
+		return;
+	}
+	if ((out = openat(fso_dstat(node), node->dstname,
+			O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode)) == -1)
+	{
+		fso_fail(op, node->dst, errno);
+		close(in);
+		return;
+	}
+	if (fso_copydata(in, out) == -1)
+		fso_fail(op, node->dst, errno);
+	else
+	{
+		if (op->preserve)
+		{
+			fchmod(out, node->st.st_mode & 07777);
+			fso_settimes(out, NULL, &node->st);
+		}
+		fso_did(op);
+	}
+	close(in);
+	close(out);
+}
+
+
+/* Copy a symbolic link, fifo or device node, from src and to dst in the
+   directories of parent, or relative to the current directory if parent
+   is NULL. */
+static void
+fso_cpother(fso_op *op, fso_node *parent, const char *src, const char *dst,
+	struct stat *st)
+{
+	int sfd = AT_FDCWD, dfd = AT_FDCWD, r;
+	const char *sname = src, *dname = dst;
+	if (parent != NULL)
+	{
+		sfd = dirfd(parent->dir);
+		dfd = parent->dstfd;
+		sname = src + strlen(parent->src) + 1;
+		dname = dst + strlen(parent->dst) + 1;
+	}
+
+	if (S_ISLNK(st->st_mode))
+	{
+		char target[PATH_MAX];
+		ssize_t n = readlinkat(sfd, sname, target, sizeof target - 1);
+		if (n == -1)
+		{
+			fso_fail(op, src, errno);
+			return;
+		}
+		target[n] = '\0';
+		r = symlinkat(target, dfd, dname);
+	}
+	else if (S_ISFIFO(st->st_mode))
+		r = mkfifoat(dfd, dname, st->st_mode & 07777);
+	else
+		r = mknodat(dfd, dname, st->st_mode, st->st_rdev);
+
+	if (r == -1)
+		fso_fail(op, dst, errno);
+	else
+	{
+		if (op->preserve)
+			fso_settimes(dfd, dname, st);
+		fso_did(op);
+	}
+}
+
+
+/* Create the destination directory, then copy every entry of the source
+   directory, handing files and subdirectories back to the pool. */
+static void
+fso_cpdir(fso_op *op, fso_node *node)
+{
+	struct dirent *e;
+	DIR *dir;
+	int fd;
+
+	/* Keep the new directory writable until all of its children are
+	   copied, and only then apply the source's mode. */
+	if (mkdirat(fso_dstat(node), node->dstname, op->preserve ? 0700 : 0777) == -1
+	    || (node->dstfd = openat(fso_dstat(node), node->dstname,
+			O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)) == -1)
+	{
+		fso_fail(op, node->dst, errno);
+		fso_markfailed(op, node);
+		return;
+	}
+	fso_did(op);
+	if ((dir = fso_opendir(op, node)) == NULL)
+		return;
+	fd = dirfd(dir);
+
+	while (!fso_cancelled(op) && (e = readdir(dir)) != NULL)
+	{
+		struct stat st;
+		char *src, *dst;
+
+		if (STREQ(e->d_name, ".") || STREQ(e->d_name, ".."))
+			continue;
+		src = fso_join(node->src, e->d_name);
+		dst = fso_join(node->dst, e->d_name);
+		if (src == NULL || dst == NULL)
+			fso_fail(op, node->src, ENOMEM);
+		else if (fstatat(fd, e->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1)
+			fso_fail(op, src, errno);
+		else if (S_ISDIR(st.st_mode) || S_ISREG(st.st_mode))
+		{
+			fso_node *child = fso_newnode(S_ISDIR(st.st_mode) ?
+				FSO_CPDIR : FSO_CPFILE, node, src, dst);
+			if (child == NULL)
+				fso_fail(op, src, ENOMEM);
+			else
+			{
+				child->st = st;
+				fso_enqueue(op, child);
+			}
+		}
+		else
+			fso_cpother(op, node, src, dst, &st);
+		free(src);
+		free(dst);
+	}
+}
+
+
+static void
+fso_run(fso_op *op, fso_node *node)
+{
+	if (!fso_cancelled(op))
+		switch (node->kind)
+		{
+			case FSO_RMDIR:
+				fso_rmdir(op, node);
+				break;
+			case FSO_UNLINK:
+				if (unlink(node->src) == -1)
+					fso_fail(op, node->src, errno);
+				else
+					fso_did(op);
+				break;
+			case FSO_CPDIR:
+				fso_cpdir(op, node);
+				break;
+			case FSO_CPFILE:
+				fso_cpfile(op, node);
+				break;
+			case FSO_CPOTHER:
+				fso_cpother(op, NULL, node->src, node->dst, &node->st);
+				break;
+		}
+	fso_release(op, node);
+}
+
+
+static void *
+fso_worker(void *arg)
+{
+	fso_op *op = arg;
+	for (;;)
+	{
+		fso_node *node;
+
+		pthread_mutex_lock(&op->lock);
+		while (op->queue == NULL && op->outstanding > 0)
+			pthread_cond_wait(&op->cond, &op->lock);
+		if ((node = op->queue) == NULL)
+		{
+			pthread_mutex_unlock(&op->lock);
+			break;
+		}
+		op->queue = node->next;
+		pthread_mutex_unlock(&op->lock);
+
+		fso_run(op, node);
+
+		pthread_mutex_lock(&op->lock);
+		if (--op->outstanding == 0)
+		{
+			op->finished = 1;
+			pthread_cond_broadcast(&op->cond);
+		}
+		pthread_mutex_unlock(&op->lock);
+		fso_notify(op);
+	}
+	return NULL;
+}
+
+
+static fso_op *
+checkop(lua_State *L, int narg)
+{
+	return (fso_op *)luaL_checkudata(L, narg, FSO_HANDLE);
+}
+
+
+/* Wait for every worker, and release everything but the userdata. */
+static void
+fso_join_all(fso_op *op)
+{
+	int i;
+	for (i = 0; i < op->nthreads; i++)
+		pthread_join(op->threads[i], NULL);
+	op->nthreads = 0;
+}
+
+
+static void
+fso_drain(fso_op *op)
+{
+	char buf[256];
+	while (read(op->fd[0], buf, sizeof buf) > 0)
+		;
+}
+
+
+static int
+fso_gc(lua_State *L)
+{
+	fso_op *op = (fso_op *)lua_touserdata(L, 1);
+	if (op->fd[0] == -1)
+		return 0;
+	op->cancelled = 1;
+	fso_join_all(op);
+	close(op->fd[0]);
+	close(op->fd[1]);
+	op->fd[0] = op->fd[1] = -1;
+	free(op->errpath);
+	op->errpath = NULL;
+	pthread_cond_destroy(&op->cond);
+	pthread_mutex_destroy(&op->lock);
+	return 0;
+}
+
+
+/***
+Operation Methods.
+@section methods
+*/
+
+
+/***
+Stop an operation as soon as possible.
+Tasks already running finish, but no new ones start.  Call @{wait}
+to be sure that every worker thread has stopped.
+@function cancel
+*/
+static int
+fso_cancel(lua_State *L)
+{
+	fso_op *op = checkop(L, 1);
+	checknargs(L, 1);
+	op->cancelled = 1;
+	return 0;
+}
+
+
+/***
+File descriptor for progress notification.
+The descriptor becomes readable whenever some work has finished, and
+when the whole operation is done.
+@function fileno
+@treturn int file descriptor to poll for reading
+@usage
+  local poll = require "posix.poll"
+  while not select(3, op:progress()) do
+    poll.rpoll(op:fileno(), -1)
+  end
+*/
+static int
+fso_fileno(lua_State *L)
+{
+	fso_op *op = checkop(L, 1);
+	checknargs(L, 1);
+	return pushintegerresult(op->fd[0]);
+}
+
+
+/***
+Report progress so far.
+Also empties the @{fileno} descriptor, so that it will not be readable
+again until more work has finished.
+@function progress
+@treturn int number of entries copied or removed
+@treturn int number of entries that failed
+@treturn bool `true` if the operation has finished
+*/
+static int
+fso_progress(lua_State *L)
+{
+	fso_op *op = checkop(L, 1);
+	checknargs(L, 1);
+	fso_drain(op);
+	pthread_mutex_lock(&op->lock);
+	lua_pushinteger(L, op->done);
+	lua_pushinteger(L, op->failed);
+	lua_pushboolean(L, op->finished);
+	pthread_mutex_unlock(&op->lock);
+	return 3;
+}
+
+
+/***
+Wait for an operation to finish.
+An operation stopped by @{cancel} before it finished fails with
+`ECANCELED`.
+@function wait
+@treturn[1] int number of entries copied or removed, if every entry
+  succeeded
+@return[2] nil
+@treturn[2] string error message for the first failure
+@treturn[2] int errnum
+@treturn[2] int number of entries that failed
+*/
+static int
+fso_wait(lua_State *L)
+{
+	fso_op *op = checkop(L, 1);
+	checknargs(L, 1);
+	fso_join_all(op);
+	fso_drain(op);
+	if (op->skipped && op->err == 0)
+	{
+		errno = ECANCELED;
+		return pusherror(L, NULL);
+	}
+	if (op->err != 0)
+	{
+		errno = op->err;
+		pusherror(L, op->errpath);
+		lua_pushinteger(L, op->failed);
+		return 4;
+	}
+	return pushintegerresult(op->done);
+}
+
+
+static const luaL_Reg fso_methods[] =
+{
+	{"cancel",	fso_cancel},
+	{"fileno",	fso_fileno},
+	{"progress",	fso_progress},
+	{"wait",	fso_wait},
+	{NULL, NULL}
+};
+
+
+static const char *Scopytree_fields[] = { "threads", "preserve" };
+static const char *Srmtree_fields[] = { "threads" };
+
+static int
+fso_optthreads(lua_State *L, int index, int nfields, const char * const fields[])
+{
+	int nthreads = 4;
+	if (lua_isnoneornil(L, index))
+		return nthreads;
+	luaL_checktype(L, index, LUA_TTABLE);
+	nthreads = optintfield(L, index, "threads", nthreads);
+	(checkfieldnames)(L, index, nfields, fields);
+	luaL_argcheck(L, nthreads >= 1 && nthreads <= FSO_MAX_THREADS, index,
+		"threads out of range");
+	return nthreads;
+}
+#define fso_optthreads(L,i,S) (fso_optthreads)(L,i,sizeof(S)/sizeof(*S),S)
+
+
+/* Push a new operation userdata, or nil, an error message and errnum. */
+static fso_op *
+fso_newop(lua_State *L, int preserve)
+{
+	fso_op *op = (fso_op *)lua_newuserdata(L, sizeof *op);
+	int i;
+	memset(op, 0, sizeof *op);
+	op->fd[0] = op->fd[1] = -1;
+	op->preserve = preserve;
+	if (pipe(op->fd) == -1)
+	{
+		lua_pop(L, 1);
+		pusherror(L, "pipe");
+		return NULL;
+	}
+	for (i = 0; i < 2; i++)
+	{
+		fcntl(op->fd[i], F_SETFL, fcntl(op->fd[i], F_GETFL) | O_NONBLOCK);
+		fcntl(op->fd[i], F_SETFD, FD_CLOEXEC);
+	}
+	pthread_mutex_init(&op->lock, NULL);
+	pthread_cond_init(&op->cond, NULL);
+
+	if (luaL_newmetatable(L, FSO_HANDLE))
+	{
+		luaL_newlib(L, fso_methods);
+		lua_setfield(L, -2, "__index");
+		lua_pushcfunction(L, fso_gc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_setmetatable(L, -2);
+	return op;
+}
+
+
+/* Queue root, and start the workers on it. */
+static int
+fso_start(lua_State *L, fso_op *op, fso_node *root, int nthreads)
+{
+	sigset_t all, old;
+	int i, err = 0;
+
+	fso_enqueue(op, root);
+
+	/* Leave signal delivery to the thread running Lua. */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	for (i = 0; i < nthreads; i++)
+		if ((err = pthread_create(&op->threads[i], NULL, fso_worker, op)) != 0)
+			break;
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	op->nthreads = i;
+
+	if (op->nthreads == 0)
+	{
+		/* Nothing else can be holding the root node. */
+		op->queue = NULL;
+		op->outstanding = 0;
+		fso_freenode(root);
+		errno = err;
+		return pusherror(L, "pthread_create");
+	}
+	return 1;
+}
+
+
+/***
+Functions.
+@section functions
+*/
+
+
+/***
+Copy a directory tree in the background.
+Directories, regular files, symbolic links, fifos and (privileges
+allowing) device nodes are copied.  File data is copied with
+`copy_file_range` where available, so that file systems supporting
+reflinks or server side copies can avoid moving the data at all.
+@function copytree
+@string src existing file or directory to copy
+@string dst destination, which must not already exist
+@tparam[opt] table opts with fields:
+@int[opt=4] opts.threads number of worker threads, from 1 to 64
+@bool[opt=false] opts.preserve copy permission bits, including setuid,
+  setgid and sticky bits, and access and modification times
+@return[1] an operation with methods @{cancel}, @{fileno}, @{progress}
+  and @{wait}, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@usage
+  local fsops = require "posix.fsops"
+  local op = fsops.copytree("src", "backup", {threads = 16, preserve = true})
+  print(op:wait())
+*/
+static int
+Pcopytree(lua_State *L)
+{
+	const char *src = luaL_checkstring(L, 1);
+	const char *dst = luaL_checkstring(L, 2);
+	int nthreads = fso_optthreads(L, 3, Scopytree_fields);
+	int preserve = lua_isnoneornil(L, 3) ? 0 : optbooleanfield(L, 3, "preserve", 0);
+	struct stat st;
+	fso_node *root;
+	fso_op *op;
+	checknargs(L, 3);
+
+	if (lstat(src, &st) == -1)
+		return pusherror(L, src);
+	if ((op = fso_newop(L, preserve)) == NULL)
+		return 3;
+	root = fso_newnode(S_ISDIR(st.st_mode) ? FSO_CPDIR :
+		S_ISREG(st.st_mode) ? FSO_CPFILE : FSO_CPOTHER, NULL, src, dst);
+	if (root == NULL)
+		return luaL_error(L, "not enough memory");
+	root->st = st;
+	return fso_start(L, op, root, nthreads);
+}
+
+
+/***
+Remove a directory tree in the background.
+Symbolic links are removed, never followed.  Entries that cannot be
+removed are counted, and leave their parent directories in place,
+while the rest of the tree is still removed.
+@function rmtree
+@string path existing file or directory to remove
+@tparam[opt] table opts with fields:
+@int[opt=4] opts.threads number of worker threads, from 1 to 64
+@return[1] an operation with methods @{cancel}, @{fileno}, @{progress}
+  and @{wait}, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@usage
+  local fsops = require "posix.fsops"
+  local n, errmsg = fsops.rmtree("build", {threads = 32}):wait()
+  if not n then error(errmsg) end
+*/
+static int
+Prmtree(lua_State *L)
+{
+	const char *path = luaL_checkstring(L, 1);
+	int nthreads = fso_optthreads(L, 2, Srmtree_fields);
+	struct stat st;
+	fso_node *root;
+	fso_op *op;
+	checknargs(L, 2);
+
+	if (lstat(path, &st) == -1)
+		return pusherror(L, path);
+	if ((op = fso_newop(L, 0)) == NULL)
+		return 3;
+	root = fso_newnode(S_ISDIR(st.st_mode) ? FSO_RMDIR : FSO_UNLINK,
+		NULL, path, NULL);
+	if (root == NULL)
+		return luaL_error(L, "not enough memory");
+	return fso_start(L, op, root, nthreads);
+}
+#endif
+
+
+static const luaL_Reg posix_fsops_fns[] =
+{
+#if HAVE_PTHREAD_H
+	LPOSIX_FUNC( Pcopytree		),
+	LPOSIX_FUNC( Prmtree		),
+#endif
+	{NULL, NULL}
+};
+
+
+LUALIB_API int
+luaopen_posix_fsops(lua_State *L)
+{
+	luaL_newlib(L, posix_fsops_fns);
+	lua_pushstring(L, LPOSIX_VERSION_STRING("fsops"));
+	lua_setfield(L, -2, "version");
+
+	return 1;
+}
@@ -13,22 +13,26 @@
  Generate pathnames matching a shell-style pattern.
 
  Functions generating a table of filenames that match a shell-style
- pattern string.
+ pattern string, or an iterator that streams them one at a time.
 
 @module posix.glob
 */
 
-#include <glob.h>
-
 #include "_helpers.c"
 
+#include <dirent.h>
+#include <fnmatch.h>
+#include <glob.h>
+#include <pwd.h>
+
 
 /***
 Find all files in this directory matching a shell pattern.
 @function glob
 @string[opt="*"] pat shell glob pattern
-@param flags bitwise inclusive OR of zero or more of `GLOB_ERR`, `GLOB_MARK`
- and `GLOB_NOCHECK`
+@param flags bitwise inclusive OR of zero or more of `GLOB_ERR`, `GLOB_MARK`,
+ `GLOB_NOCHECK`, `GLOB_NOESCAPE` and `GLOB_NOSORT` (and `GLOB_BRACE`,
+ `GLOB_ONLYDIR` and `GLOB_TILDE`, where supported)
 @treturn[1] table matching filenames, if successful
 @treturn[2] nil
 @treturn[2] one of `GLOB_ABORTED`, `GLOB_NOMATCH` or `GLOB_NOSPACE`
@@ -65,9 +69,543 @@ Pglob(lua_State *L)
 }
 
 
+#define GITER_HANDLE	PACKAGE " glob iterator"
+
+/* One directory being matched against pattern component comp.  Sorted
+   iteration reads the matching entries of the whole directory up front;
+   unsorted iteration streams entries straight from readdir. */
+typedef struct
+{
+	DIR		*d;
+	char		**list;		/* see giter_read */
+	int		n, next, cap;
+	size_t		pathlen;	/* length of this directory's path */
+	int		comp;
+} giter_frame;
+
+typedef struct
+{
+	giter_frame	*frames;
+	size_t		nframes, framecap;
+	char		*path;
+	size_t		pathcap;
+	char		*pat;		/* current pattern, split at slashes */
+	size_t		patcap;
+	const char	**comps;
+	size_t		compcap;
+	int		ncomps, dirsonly, trailing;
+	int		flags, fnmflags;
+	int		npats, curpat;
+	int		matched;
+} giter_state;
+
+
+static void *
+giter_grow(lua_State *L, void *p, size_t *cap, size_t need, size_t size)
+{
+	void *ud;
+	lua_Alloc lalloc = lua_getallocf(L, &ud);
+	size_t newcap = *cap ? *cap : 64;
+	void *r;
+	if (need <= *cap)
+		return p;
+	while (newcap < need)
+		newcap *= 2;
+	if ((r = lalloc(ud, p, *cap * size, newcap * size)) == NULL)
+		luaL_error(L, "not enough memory");
+	*cap = newcap;
+	return r;
+}
+
+
+static void
+giter_pop(giter_state *g)
+{
+	giter_frame *f = &g->frames[--g->nframes];
+	if (f->d != NULL)
+		closedir(f->d);
+	if (f->list != NULL)
+	{
+		while (f->next < f->n)
+			free(f->list[f->next++]);
+		free(f->list);
+	}
+	g->path[f->pathlen] = '\0';
+}
+
+
+static void
+giter_free(lua_State *L, giter_state *g)
+{
+	void *ud;
+	lua_Alloc lalloc = lua_getallocf(L, &ud);
+	while (g->nframes > 0)
+		giter_pop(g);
+	if (g->frames != NULL)
+		lalloc(ud, g->frames, g->framecap * sizeof *g->frames, 0);
+	if (g->path != NULL)
+		lalloc(ud, g->path, g->pathcap, 0);
+	if (g->pat != NULL)
+		lalloc(ud, g->pat, g->patcap, 0);
+	if (g->comps != NULL)
+		lalloc(ud, g->comps, g->compcap * sizeof *g->comps, 0);
+	memset(g, 0, sizeof *g);
+}
+
+
+static int
+giter_gc(lua_State *L)
+{
+	giter_free(L, (giter_state *)lua_touserdata(L, 1));
+	return 0;
+}
+
+
+static int
+giter_ismagic(const char *s, int noescape)
+{
+	for (; *s; s++)
+		if (*s == '*' || *s == '?' || *s == '[' || (*s == '\\' && !noescape))
+			return 1;
+	return 0;
+}
+
+
+/* Append the pattern expansions of s[0..len) to the table at t, expanding
+   the first brace group with a top-level comma, and then recursing on
+   each alternative to expand any later groups. */
+static void
+giter_brace(lua_State *L, int t, const char *s, size_t len, int noescape)
+{
+	size_t i, j, start = 0, alt;
+	for (i = 0; i < len; i++)
+	{
+		int depth = 0, commas = 0;
+		if (s[i] == '\\' && !noescape)
+		{
+			i++;
+			continue;
+		}
+		if (s[i] != '{')
+			continue;
+		for (j = i; j < len; j++)
+		{
+			if (s[j] == '\\' && !noescape)
+				j++;
+			else if (s[j] == '{')
+				depth++;
+			else if (s[j] == ',' && depth == 1)
+				commas++;
+			else if (s[j] == '}' && --depth == 0)
+				break;
+		}
+		if (j >= len || commas == 0)
+			continue;
+
+		depth = 0;
+		for (alt = start = i + 1; alt <= j; alt++)
+		{
+			if (s[alt] == '\\' && !noescape)
+			{
+				alt++;
+				continue;
+			}
+			if (s[alt] == '{')
+				depth++;
+			else if (s[alt] == '}' && alt < j)
+				depth--;
+			if (depth != 0 || (alt < j && s[alt] != ','))
+				continue;
+			{
+				luaL_Buffer b;
+				luaL_buffinit(L, &b);
+				luaL_addlstring(&b, s, i);
+				luaL_addlstring(&b, s + start, alt - start);
+				luaL_addlstring(&b, s + j + 1, len - j - 1);
+				luaL_pushresult(&b);
+			}
+			giter_brace(L, t, lua_tostring(L, -1), lua_rawlen(L, -1), noescape);
+			lua_pop(L, 1);
+			start = alt + 1;
+		}
+		return;
+	}
+	lua_pushlstring(L, s, len);
+	lua_rawseti(L, t, (int)lua_rawlen(L, t) + 1);
+}
+
+/* Make path name dir/name, where dir is the first pathlen bytes of
+   g->path. */
+static void
+giter_setpath(lua_State *L, giter_state *g, size_t pathlen, const char *name)
+{
+	size_t n = strlen(name);
+	int sep = pathlen > 0 && g->path[pathlen - 1] != '/';
+	g->path = giter_grow(L, g->path, &g->pathcap, pathlen + sep + n + 1, 1);
+	if (sep)
+		g->path[pathlen] = '/';
+	memcpy(g->path + pathlen + sep, name, n + 1);
+}
+
+
+static int
+giter_isdir(const char *path)
+{
+	struct stat st;
+	return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+
+/* Load pattern number g->curpat from the table upvalue, and split it
+   into components. */
+static void
+giter_setpattern(lua_State *L, giter_state *g)
+{
+	const char *pat, *home = NULL;
+	size_t len, skip = 0;
+	char *p;
+
+	lua_rawgeti(L, lua_upvalueindex(2), ++g->curpat);
+	pat = lua_tolstring(L, -1, &len);
+
+#ifdef GLOB_TILDE
+	if ((g->flags & GLOB_TILDE) && pat[0] == '~')
+	{
+		struct passwd *pw;
+		skip = strcspn(pat, "/");
+		if (skip == 1)
+		{
+			home = getenv("HOME");
+			if (home == NULL && (pw = getpwuid(getuid())) != NULL)
+				home = pw->pw_dir;
+		}
+		else
+		{
+			lua_pushlstring(L, pat + 1, skip - 1);
+			if ((pw = getpwnam(lua_tostring(L, -1))) != NULL)
+				home = pw->pw_dir;
+			lua_pop(L, 1);
+		}
+		if (home == NULL)
+			skip = 0;
+	}
+#endif
+	if (home != NULL)
+	{
+		lua_pushfstring(L, "%s%s", home, pat + skip);
+		lua_remove(L, -2);
+		pat = lua_tolstring(L, -1, &len);
+	}
+
+	g->pat = giter_grow(L, g->pat, &g->patcap, len + 1, 1);
+	memcpy(g->pat, pat, len + 1);
+	lua_pop(L, 1);
+
+	g->ncomps = 0;
+	for (p = g->pat; *p; )
+	{
+		if (*p == '/')
+		{
+			*p++ = '\0';
+			continue;
+		}
+		g->comps = giter_grow(L, g->comps, &g->compcap, g->ncomps + 1, sizeof *g->comps);
+		g->comps[g->ncomps++] = p;
+		p += strcspn(p, "/");
+	}
+	/* Like glob, GLOB_ONLYDIR only applies to names matched by wildcards,
+	   but a trailing slash applies to literal names too. */
+	g->trailing = g->dirsonly = len > 0 && g->pat[len - 1] == '\0';
+#ifdef GLOB_ONLYDIR
+	g->dirsonly |= (g->flags & GLOB_ONLYDIR) != 0;
+#endif
+
+	/* Splitting leaves a leading NUL in absolute patterns. */
+	g->path = giter_grow(L, g->path, &g->pathcap, 2, 1);
+	strcpy(g->path, len > 0 && g->pat[0] == '\0' ? "/" : "");
+}
+
+static int
+giter_cmp(const void *a, const void *b)
+{
+	return strcoll(*(char * const *)a, *(char * const *)b);
+}
+
+
+/* Read the entries of dir matching the component of frame f into
+   f->list, sorted by the rest of the path that each one would produce:
+   a directory is followed by a slash when the match continues below it,
+   or when the match will be marked.  Because names cannot contain
+   slashes, sorting those keys orders matches just as glob sorts whole
+   paths.  Each key is followed by its NUL and then a byte that is 1 for
+   a directory, 0 for anything else, or -1 if it was not checked. */
+static int
+giter_read(lua_State *L, giter_state *g, giter_frame *f, const char *dir)
+{
+	int final = f->comp == g->ncomps - 1;
+	int mark = g->trailing || (g->flags & GLOB_MARK);
+	struct dirent *e;
+
+	if ((f->d = opendir(dir)) == NULL)
+		return -1;
+	while ((e = readdir(f->d)) != NULL)
+	{
+		int isdir = -1, slash = !final;
+		size_t n;
+		char *key;
+
+		if (fnmatch(g->comps[f->comp], e->d_name, g->fnmflags) != 0)
+			continue;
+		if (final && (g->dirsonly || mark))
+		{
+			giter_setpath(L, g, f->pathlen, e->d_name);
+			isdir = giter_isdir(g->path);
+			g->path[f->pathlen] = '\0';
+			if (g->dirsonly && !isdir)
+				continue;
+			slash = isdir && mark;
+		}
+
+		if (f->n == f->cap)
+		{
+			int cap = f->cap ? 2 * f->cap : 16;
+			char **list = realloc(f->list, cap * sizeof *list);
+			if (list == NULL)
+				luaL_error(L, "not enough memory");
+			f->list = list;
+			f->cap = cap;
+		}
+		n = strlen(e->d_name);
+		if ((key = malloc(n + slash + 2)) == NULL)
+			luaL_error(L, "not enough memory");
+		memcpy(key, e->d_name, n);
+		if (slash)
+			key[n++] = '/';
+		key[n] = '\0';
+		key[n + 1] = (char)isdir;
+		f->list[f->n++] = key;
+	}
+	closedir(f->d);
+	f->d = NULL;
+	qsort(f->list, f->n, sizeof *f->list, giter_cmp);
+	return 0;
+}
+
+
+/* Starting from the directory in g->path, append literal pattern
+   components from comp onwards without reading any directories, then
+   push a frame to match the next component with wildcards.  Returns 1
+   if the pattern is used up and g->path is a match. */
+static int
+giter_enter(lua_State *L, giter_state *g, int comp)
+{
+	giter_frame *f;
+	const char *dir;
+	struct stat st;
+	int noescape = 0, ok;
+
+#ifdef GLOB_NOESCAPE
+	noescape = (g->flags & GLOB_NOESCAPE) != 0;
+#endif
+	while (comp < g->ncomps && !giter_ismagic(g->comps[comp], noescape))
+		giter_setpath(L, g, strlen(g->path), g->comps[comp++]);
+	if (comp == g->ncomps)
+		return g->path[0] != '\0' && lstat(g->path, &st) == 0
+			&& (!g->trailing || giter_isdir(g->path));
+
+	/* Push the frame first, so that its memory is released if reading
+	   raises an error. */
+	g->frames = giter_grow(L, g->frames, &g->framecap, g->nframes + 1, sizeof *g->frames);
+	f = &g->frames[g->nframes++];
+	memset(f, 0, sizeof *f);
+	f->pathlen = strlen(g->path);
+	f->comp = comp;
+	dir = f->pathlen ? g->path : ".";
+#ifdef GLOB_NOSORT
+	if (g->flags & GLOB_NOSORT)
+		ok = (f->d = opendir(dir)) != NULL;
+	else
+#endif
+	ok = giter_read(L, g, f, dir) == 0;
+
+	if (!ok)
+	{
+		g->nframes--;
+		if ((g->flags & GLOB_ERR) && errno != ENOENT && errno != ENOTDIR)
+			luaL_error(L, "%s: %s", dir, strerror(errno));
+	}
+	return 0;
+}
+
+
+/* Name of the next entry in frame f, or NULL at the end, setting *isdir
+   as described for giter_read.  Sorted entries are freed as they are
+   consumed. */
+static const char *
+giter_next(giter_frame *f, char **prev, int *isdir)
+{
+	struct dirent *e;
+	size_t len;
+	if (*prev != NULL)
+	{
+		free(*prev);
+		*prev = NULL;
+	}
+	*isdir = -1;
+	if (f->d != NULL)
+		return (e = readdir(f->d)) ? e->d_name : NULL;
+	if (f->next >= f->n)
+		return NULL;
+	*prev = f->list[f->next++];
+	len = strlen(*prev);
+	*isdir = (signed char)(*prev)[len + 1];
+	if (len > 0 && (*prev)[len - 1] == '/')
+		(*prev)[len - 1] = '\0';
+	return *prev;
+}
+
+
+static int
+giter_result(lua_State *L, giter_state *g, int isdir)
+{
+	size_t len = strlen(g->path);
+	g->matched = 1;
+	if (((g->flags & GLOB_MARK) || g->trailing) && g->path[len - 1] != '/'
+	    && (isdir >= 0 ? isdir : giter_isdir(g->path)))
+		lua_pushfstring(L, "%s/", g->path);
+	else
+		lua_pushstring(L, g->path);
+	return 1;
+}
+
+
+static int
+aux_glob(lua_State *L)
+{
+	giter_state *g = (giter_state *)luaL_checkudata(L, lua_upvalueindex(1), GITER_HANDLE);
+
+	for (;;)
+	{
+		giter_frame *f;
+		char *prev = NULL;
+		const char *name;
+		int comp, isdir;
+
+		if (g->nframes == 0)
+		{
+			if (g->curpat >= g->npats)
+				break;
+			giter_setpattern(L, g);
+			if (giter_enter(L, g, 0))
+				return giter_result(L, g, -1);
+			continue;
+		}
+
+		/* Sorted entries have already been matched by giter_read. */
+		f = &g->frames[g->nframes - 1];
+		comp = f->comp;
+		while ((name = giter_next(f, &prev, &isdir)) != NULL)
+			if (f->d == NULL || fnmatch(g->comps[comp], name, g->fnmflags) == 0)
+				break;
+		if (name == NULL)
+		{
+			giter_pop(g);
+			continue;
+		}
+		giter_setpath(L, g, f->pathlen, name);
+		free(prev);
+
+		if (comp == g->ncomps - 1)
+		{
+			if (!g->dirsonly || (isdir >= 0 ? isdir : giter_isdir(g->path)))
+				return giter_result(L, g, isdir);
+		}
+		else if (giter_enter(L, g, comp + 1))
+			return giter_result(L, g, -1);
+	}
+
+	/* Every pattern is used up. */
+	if (!g->matched && (g->flags & GLOB_NOCHECK))
+	{
+		g->matched = 1;
+		lua_pushvalue(L, lua_upvalueindex(3));
+		return 1;
+	}
+	giter_free(L, g);
+	return 0;
+}
+
+
+/***
+Iterate over files matching a shell pattern, without collecting them all
+first.
+Each directory is read only when the iteration reaches it, so with
+`GLOB_NOSORT` the first matches are available straight away, and memory
+use does not grow with the number of matches.  Otherwise, the matching
+entries of each directory are sorted as it is reached, in an order that
+returns whole paths in the same order as @{glob} does in the `"C"`
+locale.  Hidden files only match a pattern component that starts with
+a period.  As with @{glob}, `GLOB_ONLYDIR` only excludes names matched
+by a wildcard, so a literal last component, such as `z` in `"c/?/e/z"`,
+is returned even if it is a file, but a trailing slash in *pat* always
+excludes names that are not directories.
+@function iter
+@string[opt="*"] pat shell glob pattern
+@int[opt=0] flags bitwise inclusive OR of zero or more of `GLOB_ERR`,
+  `GLOB_MARK`, `GLOB_NOCHECK`, `GLOB_NOESCAPE` and `GLOB_NOSORT` (and
+  `GLOB_BRACE`, `GLOB_ONLYDIR` and `GLOB_TILDE`, where supported)
+@return an iterator, returning each matching path in turn; with
+  `GLOB_ERR`, it raises an error on reaching a non-readable directory
+@see glob
+@usage
+  local glob = require "posix.glob"
+  for path in glob.iter("logs/2024-*.log", glob.GLOB_NOSORT) do
+    process(path)
+  end
+*/
+static int
+Piter(lua_State *L)
+{
+	const char *pattern = optstring(L, 1, "*");
+	int flags = optint(L, 2, 0);
+	int noescape = 0;
+	giter_state *g;
+	checknargs(L, 2);
+
+#ifdef GLOB_NOESCAPE
+	noescape = (flags & GLOB_NOESCAPE) != 0;
+#endif
+	g = (giter_state *)lua_newuserdata(L, sizeof *g);
+	memset(g, 0, sizeof *g);
+	g->flags = flags;
+	g->fnmflags = FNM_PERIOD | (noescape ? FNM_NOESCAPE : 0);
+	if (luaL_newmetatable(L, GITER_HANDLE))
+	{
+		lua_pushcfunction(L, giter_gc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_setmetatable(L, -2);
+
+	lua_newtable(L);
+#ifdef GLOB_BRACE
+	if (flags & GLOB_BRACE)
+		giter_brace(L, lua_gettop(L), pattern, strlen(pattern), noescape);
+	else
+#endif
+	{
+		lua_pushstring(L, pattern);
+		lua_rawseti(L, -2, 1);
+	}
+	g->npats = (int)lua_rawlen(L, -1);
+	lua_pushstring(L, pattern);
+	lua_pushcclosure(L, aux_glob, 3);
+	return 1;
+}
+
 static const luaL_Reg posix_glob_fns[] =
 {
 	LPOSIX_FUNC( Pglob		),
+	LPOSIX_FUNC( Piter		),
 	{NULL, NULL}
 };
 
@@ -79,11 +617,17 @@ Constants.
 
 /***
 Glob constants.
+Any constants not available in the underlying system will be `nil` valued.
 @table posix.glob
 @int GLOB_MARK append slashes to matches that are directories.
 @int GLOB_ERR instead of ignoring non-readable directories, return GLOB_ABORTED
 @int GLOB_ABORTED encountered a non-readable directory
+@int GLOB_BRACE expand `{a,b}` alternatives, as in csh
 @int GLOB_NOCHECK return the original pattern if there are no matches
+@int GLOB_NOESCAPE backslash does not quote special characters
+@int GLOB_NOSORT return matches in directory order, without sorting
+@int GLOB_ONLYDIR match only directories
+@int GLOB_TILDE expand a leading `~` or `~user` to a home directory
 @int GLOB_NOMATCH pattern does not match any existing pathname
 @int GLOB_NOSPACE not enough memory to continue
 @usage
@@ -105,6 +649,17 @@ luaopen_posix_glob(lua_State *L)
 	LPOSIX_CONST( GLOB_ERR );
 	LPOSIX_CONST( GLOB_MARK );
 	LPOSIX_CONST( GLOB_NOCHECK );
+	LPOSIX_CONST( GLOB_NOESCAPE );
+	LPOSIX_CONST( GLOB_NOSORT );
+#ifdef GLOB_BRACE
+	LPOSIX_CONST( GLOB_BRACE );
+#endif
+#ifdef GLOB_ONLYDIR
+	LPOSIX_CONST( GLOB_ONLYDIR );
+#endif
+#ifdef GLOB_TILDE
+	LPOSIX_CONST( GLOB_TILDE );
+#endif
 	LPOSIX_CONST( GLOB_ABORTED );
 	LPOSIX_CONST( GLOB_NOMATCH );
 	LPOSIX_CONST( GLOB_NOSPACE );
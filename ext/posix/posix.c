@@ -10,26 +10,37 @@
  * With documentation from Steve Donovan 2012
  */
 
+/* Feature test macros must precede the first system header.  */
+#include "_helpers.c"
+
 #include "ctype.c"
+#include "deadline.c"
 #include "dirent.c"
 #include "errno.c"
 #include "fcntl.c"
 #include "fnmatch.c"
+#include "fsops.c"
 #include "glob.c"
 #include "grp.c"
 #include "libgen.c"
 #include "poll.c"
+#include "prefork.c"
 #include "pwd.c"
 #include "sched.c"
 #include "signal.c"
+#include "spawn.c"
 #include "stdio.c"
 #include "stdlib.c"
+#include "sys/eventfd.c"
+#include "sys/inotify.c"
 #include "sys/msg.c"
+#include "sys/pidfd.c"
 #include "sys/resource.c"
 #include "sys/socket.c"
 #include "sys/stat.c"
 #include "sys/statvfs.c"
 #include "sys/time.c"
+#include "sys/timerfd.c"
 #include "sys/times.c"
 #include "sys/utsname.c"
 #include "sys/wait.c"
@@ -0,0 +1,813 @@
+/*
+ * POSIX library for Lua 5.1, 5.2, 5.3 & 5.4.
+ * Copyright (C) 2013-2025 Gary V. Vaughan
+ * Copyright (C) 2010-2013 Reuben Thomas <rrt@sc3d.org>
+ * Copyright (C) 2008-2010 Natanael Copa <natanael.copa@gmail.com>
+ * Clean up and bug fixes by Leo Razoumov <slonik.az@gmail.com> 2006-10-11
+ * Luiz Henrique de Figueiredo <lhf@tecgraf.puc-rio.br> 07 Apr 2006 23:17:49
+ * Based on original by Claudio Terra for Lua 3.x.
+ * With contributions by Roberto Ierusalimschy.
+ * With documentation from Steve Donovan 2012
+ */
+/***
+ Prefork Worker Pools.
+
+ A supervisor that keeps a fixed number of forked worker processes
+ running.  Workers that exit are reaped and respawned, with exponential
+ backoff for workers that keep exiting soon after they start, so that a
+ broken worker cannot cause a respawn storm.  Where supported, each
+ worker is tracked with a pidfd, so the supervisor sleeps until a worker
+ exits rather than polling; otherwise exited workers are noticed within
+ 100 milliseconds.  Only the pool's own workers are ever reaped, and
+ closing or collecting the pool stops and reaps all of them, so that
+ none are left unsupervised.
+
+ The supervisor and workers share a scoreboard in anonymous shared
+ memory, where each worker can publish a short status string and a
+ request count, and where the supervisor asks workers to stop for a
+ graceful @{reload} or @{drain}.
+
+@module posix.prefork
+*/
+
+#include "_helpers.c"
+
+#include <poll.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#if HAVE_SYS_PIDFD_H && HAVE_PIDFD_OPEN
+#include <sys/pidfd.h>
+#endif
+
+#ifndef MAP_ANONYMOUS
+#  define MAP_ANONYMOUS	MAP_ANON
+#endif
+
+#define PREFORK_HANDLE	PACKAGE " prefork pool"
+#define PF_STATUS_MAX	16
+#define PF_POLL_MS	100
+
+/* One shared scoreboard entry per worker slot.  Each field has a single
+   writer: the worker sets status and requests, and the supervisor sets
+   everything else. */
+typedef struct
+{
+	pid_t		pid;
+	unsigned	generation;
+	int		stop;
+	lua_Integer	requests;
+	lua_Integer	restarts;
+	lua_Integer	started;	/* CLOCK_MONOTONIC milliseconds */
+	char		status[PF_STATUS_MAX];
+} pf_score;
+
+/* Supervisor bookkeeping for a worker slot. */
+typedef struct
+{
+	pid_t		pid;		/* 0 when no worker is running */
+	int		pidfd;		/* -1 when not open */
+	unsigned	generation;
+	int		fails;		/* consecutive early exits */
+	lua_Integer	started, respawn_at;
+} pf_slot;
+
+typedef struct
+{
+	pf_score	*board;
+	size_t		boardsize;
+	int		nslots;
+	int		self;		/* worker slot, or -1 in the supervisor */
+	pid_t		owner;		/* pid of the supervisor */
+	int		draining;
+	int		stopsig;
+	unsigned	generation;
+	lua_Integer	backoff, backoff_max, min_uptime;
+	pf_slot		slots[1];	/* actually nslots long */
+} pf_pool;
+
+
+static pf_pool *
+checkpool(lua_State *L, int narg)
+{
+	return (pf_pool *)luaL_checkudata(L, narg, PREFORK_HANDLE);
+}
+
+
+static pf_pool *
+checksupervisor(lua_State *L, int narg)
+{
+	pf_pool *p = checkpool(L, narg);
+	if (p->self >= 0)
+		luaL_error(L, "prefork pool method not available in a worker");
+	if (p->board == NULL)
+		luaL_error(L, "attempt to use a closed prefork pool");
+	return p;
+}
+
+
+static pf_pool *
+checkworker(lua_State *L, int narg)
+{
+	pf_pool *p = checkpool(L, narg);
+	if (p->self < 0)
+		luaL_error(L, "prefork pool method only available in a worker");
+	return p;
+}
+
+
+static lua_Integer
+pf_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (lua_Integer)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+static void
+pf_setstatus(pf_score *score, const char *status)
+{
+	strncpy(score->status, status, PF_STATUS_MAX - 1);
+	score->status[PF_STATUS_MAX - 1] = '\0';
+}
+
+
+/* Run the worker function in a freshly forked child, and exit with its
+   result.  Never returns. */
+static void
+pf_runworker(lua_State *L, pf_pool *p, int i, int poolidx)
+{
+	int j, code = 0;
+
+	p->self = i;
+	for (j = 0; j < p->nslots; j++)
+		if (p->slots[j].pidfd != -1)
+		{
+			close(p->slots[j].pidfd);
+			p->slots[j].pidfd = -1;
+		}
+	p->board[i].pid = getpid();
+
+	lua_getuservalue(L, poolidx);
+	lua_rawgeti(L, -1, 1);
+	lua_pushinteger(L, i + 1);
+	lua_pushvalue(L, poolidx);
+	if (lua_pcall(L, 2, 1, 0) != 0)
+	{
+		const char *msg = lua_tostring(L, -1);
+		fprintf(stderr, "prefork worker %d: %s\n", i + 1, msg ? msg : "error");
+		code = 1;
+	}
+	else if (lua_isnumber(L, -1))
+		code = (int)lua_tointeger(L, -1);
+	fflush(NULL);
+	_exit(code);
+}
+
+
+/* Fork a worker into slot *i*, or schedule a retry if fork fails. */
+static void
+pf_spawn(lua_State *L, pf_pool *p, int i, int poolidx, lua_Integer now)
+{
+	pf_slot *slot = &p->slots[i];
+	pf_score *score = &p->board[i];
+	pid_t pid;
+
+	score->generation = p->generation;
+	score->stop = 0;
+	score->requests = 0;
+	score->started = now;
+	pf_setstatus(score, "starting");
+
+	/* Don't let the worker flush output buffered by the supervisor. */
+	fflush(NULL);
+	pid = fork();
+	if (pid == -1)
+	{
+		slot->respawn_at = now + p->backoff;
+		return;
+	}
+	if (pid == 0)
+		pf_runworker(L, p, i, poolidx);
+
+	score->pid = pid;
+	score->restarts++;
+	slot->pid = pid;
+	slot->generation = p->generation;
+	slot->started = now;
+#if HAVE_SYS_PIDFD_H && HAVE_PIDFD_OPEN
+	/* Not yet reaped, so the pid cannot have been reused. */
+	slot->pidfd = pidfd_open(pid, 0);
+#endif
+}
+
+
+static void
+pf_respawn(lua_State *L, pf_pool *p, int poolidx, lua_Integer now)
+{
+	int i;
+	if (p->draining)
+		return;
+	for (i = 0; i < p->nslots; i++)
+		if (p->slots[i].pid == 0 && p->slots[i].respawn_at <= now)
+			pf_spawn(L, p, i, poolidx, now);
+}
+
+
+/* Reap exited workers, and schedule their replacements.  Workers that
+   were asked to stop, or that ran for at least min_uptime, are replaced
+   at once; otherwise the delay doubles with each consecutive early exit. */
+static void
+pf_reap(pf_pool *p, lua_Integer now)
+{
+	int i, status;
+	for (i = 0; i < p->nslots; i++)
+	{
+		pf_slot *slot = &p->slots[i];
+		pid_t r;
+		if (slot->pid == 0)
+			continue;
+		while ((r = waitpid(slot->pid, &status, WNOHANG)) == -1 && errno == EINTR)
+			;
+		if (r == 0 || (r == -1 && errno != ECHILD))
+			continue;
+
+		if (slot->pidfd != -1)
+		{
+			close(slot->pidfd);
+			slot->pidfd = -1;
+		}
+		slot->pid = 0;
+		p->board[i].pid = 0;
+		pf_setstatus(&p->board[i], "exited");
+
+		if (p->board[i].stop || slot->generation != p->generation
+		    || now - slot->started >= p->min_uptime)
+		{
+			slot->fails = 0;
+			slot->respawn_at = now;
+		}
+		else
+		{
+			lua_Integer delay = p->backoff;
+			int n;
+			for (n = slot->fails++; n > 0 && delay < p->backoff_max; n--)
+				delay *= 2;
+			slot->respawn_at = now + (delay < p->backoff_max ? delay : p->backoff_max);
+		}
+	}
+}
+
+
+/* Spawn due workers, wait up to *timeout* milliseconds for one to exit
+   or for a respawn to fall due, then reap and respawn again.  Returns
+   the number of running workers, or -1 with errno set. */
+static int
+pf_step(lua_State *L, pf_pool *p, int poolidx, int timeout)
+{
+	struct pollfd *fds;
+	lua_Integer now = pf_now(), wait = timeout;
+	int i, nfds = 0, live = 0, pending = 0;
+
+	pf_respawn(L, p, poolidx, now);
+
+	fds = (struct pollfd *)lua_newuserdata(L, p->nslots * sizeof *fds);
+	for (i = 0; i < p->nslots; i++)
+	{
+		pf_slot *slot = &p->slots[i];
+		if (slot->pid != 0)
+		{
+			live++;
+			if (slot->pidfd == -1)
+				pending = 1;
+			else
+			{
+				fds[nfds].fd = slot->pidfd;
+				fds[nfds].events = POLLIN;
+				fds[nfds++].revents = 0;
+			}
+		}
+		else if (!p->draining)
+		{
+			lua_Integer due = slot->respawn_at - now;
+			if (due < 0)
+				due = 0;
+			if (wait < 0 || due < wait)
+				wait = due;
+		}
+	}
+	/* Without a pidfd for every worker, poll for exits periodically. */
+	if (pending && (wait < 0 || wait > PF_POLL_MS))
+		wait = PF_POLL_MS;
+
+	if (live > 0 || wait >= 0)
+	{
+		if (poll(fds, nfds, (int)wait) == -1 && errno != EINTR)
+		{
+			lua_pop(L, 1);
+			return -1;
+		}
+	}
+	lua_pop(L, 1);
+
+	now = pf_now();
+	pf_reap(p, now);
+	pf_respawn(L, p, poolidx, now);
+
+	for (live = 0, i = 0; i < p->nslots; i++)
+		if (p->slots[i].pid != 0)
+			live++;
+	return live;
+}
+
+
+/* Ask every running worker to stop, by setting its scoreboard stop flag
+   and sending stopsig.  Returns the number of workers asked. */
+static int
+pf_stopall(pf_pool *p)
+{
+	int i, n = 0;
+	for (i = 0; i < p->nslots; i++)
+	{
+		pf_slot *slot = &p->slots[i];
+		if (slot->pid == 0)
+			continue;
+		p->board[i].stop = 1;
+		if (p->stopsig != 0)
+			kill(slot->pid, p->stopsig);
+		n++;
+	}
+	return n;
+}
+
+
+/***
+Pool Methods.
+@section methods
+*/
+
+
+/***
+Supervise the pool for a while.
+Starts any workers that are due, waits for a worker to exit, and reaps
+and respawns exited workers.  Call this in a loop, or use @{run}.
+@function step
+@int[opt=-1] timeout maximum milliseconds to wait, or `-1` to wait until
+  a worker exits or a respawn falls due
+@treturn[1] int number of running workers, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@usage
+  while not stopping do
+    pool:step(1000)
+  end
+*/
+static int
+pf_step_method(lua_State *L)
+{
+	pf_pool *p = checksupervisor(L, 1);
+	int timeout = optint(L, 2, -1);
+	int live;
+	checknargs(L, 2);
+	live = pf_step(L, p, 1, timeout);
+	if (live == -1)
+		return pusherror(L, "poll");
+	return pushintegerresult(live);
+}
+
+
+/***
+Supervise the pool until it has been drained.
+C code cannot be interrupted by Lua signal handlers from
+@{posix.signal.signal}, so pass a *callback* in order to react to
+signals, for example by calling @{reload} or @{drain}.
+@function run
+@func[opt] callback called with the pool after every step
+@int[opt] tick maximum milliseconds between calls to *callback*,
+  default `1000` with a *callback*, or else `-1` to wait indefinitely
+@treturn[1] int `0`, once @{drain} has been called and every worker
+  has exited
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@usage
+  local signal = require "posix.signal"
+  local hup, term
+  signal.signal(signal.SIGHUP, function() hup = true end)
+  signal.signal(signal.SIGTERM, function() term = true end)
+  pool:run(function(pool)
+    if hup then hup = false; pool:reload() end
+    if term then term = false; pool:drain() end
+  end)
+*/
+static int
+pf_run(lua_State *L)
+{
+	pf_pool *p = checksupervisor(L, 1);
+	int hascallback = !lua_isnoneornil(L, 2);
+	int tick, live;
+	if (hascallback)
+		luaL_checktype(L, 2, LUA_TFUNCTION);
+	tick = optint(L, 3, hascallback ? 1000 : -1);
+	checknargs(L, 3);
+
+	for (;;)
+	{
+		if ((live = pf_step(L, p, 1, tick)) == -1)
+			return pusherror(L, "poll");
+		if (hascallback)
+		{
+			lua_pushvalue(L, 2);
+			lua_pushvalue(L, 1);
+			lua_call(L, 1, 0);
+		}
+		if (p->draining && live == 0)
+			return pushintegerresult(0);
+	}
+}
+
+
+/***
+Gracefully replace every worker.
+Bumps the pool generation and asks each running worker to stop.  As
+each old worker exits it is replaced straight away, without backoff.
+@function reload
+@treturn int number of workers asked to stop
+*/
+static int
+pf_reload(lua_State *L)
+{
+	pf_pool *p = checksupervisor(L, 1);
+	checknargs(L, 1);
+	p->generation++;
+	return pushintegerresult(pf_stopall(p));
+}
+
+
+/***
+Stop respawning workers, and ask every running worker to stop.
+Keep calling @{step} until it returns `0`, or use @{run}, to wait for
+the workers to finish.
+@function drain
+@treturn int number of workers asked to stop
+*/
+static int
+pf_drain(lua_State *L)
+{
+	pf_pool *p = checksupervisor(L, 1);
+	checknargs(L, 1);
+	p->draining = 1;
+	return pushintegerresult(pf_stopall(p));
+}
+
+
+/***
+Prefork scoreboard entry.
+@table PosixPreforkScore
+@int slot worker slot number, from `1`
+@int pid process id of the worker, or `0` if none is running
+@int generation pool generation the worker was started in
+@string status last status published by the worker with @{report}
+@int requests request count published by the worker with @{report}
+@int restarts number of times a worker has been started in this slot
+@int started `CLOCK_MONOTONIC` time the worker was started, in
+  milliseconds
+@bool stop whether the worker has been asked to stop
+*/
+
+/***
+Read the shared scoreboard.
+@function scoreboard
+@treturn table list of @{PosixPreforkScore}, one per worker slot
+@usage
+  for _, score in ipairs(pool:scoreboard()) do
+    print(score.slot, score.pid, score.status, score.requests)
+  end
+*/
+static int
+pf_scoreboard(lua_State *L)
+{
+	pf_pool *p = checkpool(L, 1);
+	int i;
+	checknargs(L, 1);
+	if (p->board == NULL)
+		return luaL_error(L, "attempt to use a closed prefork pool");
+
+	lua_createtable(L, p->nslots, 0);
+	for (i = 0; i < p->nslots; i++)
+	{
+		pf_score *score = &p->board[i];
+		char status[PF_STATUS_MAX];
+		memcpy(status, score->status, sizeof status);
+		status[PF_STATUS_MAX - 1] = '\0';
+
+		lua_createtable(L, 0, 8);
+		pushintegerfield("slot", i + 1);
+		setintegerfield(score, pid);
+		setintegerfield(score, generation);
+		lua_pushstring(L, status);
+		lua_setfield(L, -2, "status");
+		setintegerfield(score, requests);
+		setintegerfield(score, restarts);
+		setintegerfield(score, started);
+		lua_pushboolean(L, score->stop);
+		lua_setfield(L, -2, "stop");
+		settypemetatable("PosixPreforkScore");
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
+
+/***
+Publish worker status to the scoreboard.
+Only available in a worker.
+@function report
+@string[opt] status short status, such as `"idle"` or `"busy"`,
+  truncated to 15 bytes
+@int[opt=0] n number of requests to add to the request count
+@treturn int the updated request count
+@usage
+  pool:report("busy")
+  handle(conn)
+  pool:report("idle", 1)
+*/
+static int
+pf_report(lua_State *L)
+{
+	pf_pool *p = checkworker(L, 1);
+	const char *status = optstring(L, 2, NULL);
+	lua_Integer n = optinteger(L, 3, 0);
+	pf_score *score = &p->board[p->self];
+	checknargs(L, 3);
+	if (status != NULL)
+		pf_setstatus(score, status);
+	score->requests += n;
+	return pushintegerresult(score->requests);
+}
+
+
+/***
+Whether the supervisor has asked this worker to stop.
+Only available in a worker.  Workers that check this between requests
+can finish the request in hand before exiting, without needing a
+handler for the stop signal.
+@function stopping
+@treturn boolean `true` if this worker should exit
+@usage
+  while not pool:stopping() do
+    serve_one(listener)
+  end
+*/
+static int
+pf_stopping(lua_State *L)
+{
+	pf_pool *p = checkworker(L, 1);
+	checknargs(L, 1);
+	return pushboolresult(p->board[p->self].stop);
+}
+
+
+/***
+The worker slot of the calling process.
+@function slot
+@treturn[1] int worker slot number, from `1`, in a worker
+@return[2] nil in the supervisor
+*/
+static int
+pf_slotnum(lua_State *L)
+{
+	pf_pool *p = checkpool(L, 1);
+	checknargs(L, 1);
+	if (p->self < 0)
+		return lua_pushnil(L), 1;
+	return pushintegerresult(p->self + 1);
+}
+
+
+/* Stop every worker, killing any still running after *timeout*
+   milliseconds, reap them all, and release the scoreboard.  In a worker,
+   or any other process forked from the supervisor, only release that
+   process's own mapping of the scoreboard.  Returns the number of
+   workers that had to be killed. */
+static int
+pf_close(pf_pool *p, lua_Integer timeout)
+{
+	lua_Integer deadline = pf_now() + timeout;
+	int i, live, killed = 0;
+
+	if (p->board == NULL)
+		return 0;
+	if (getpid() == p->owner)
+	{
+		p->draining = 1;
+		live = pf_stopall(p);
+		while (live > 0 && pf_now() < deadline)
+		{
+			poll(NULL, 0, PF_POLL_MS / 10);
+			pf_reap(p, pf_now());
+			for (live = 0, i = 0; i < p->nslots; i++)
+				if (p->slots[i].pid != 0)
+					live++;
+		}
+		for (i = 0; i < p->nslots; i++)
+		{
+			pf_slot *slot = &p->slots[i];
+			if (slot->pid == 0)
+				continue;
+			kill(slot->pid, SIGKILL);
+			while (waitpid(slot->pid, NULL, 0) == -1 && errno == EINTR)
+				;
+			slot->pid = 0;
+			killed++;
+		}
+	}
+	for (i = 0; i < p->nslots; i++)
+		if (p->slots[i].pidfd != -1)
+		{
+			close(p->slots[i].pidfd);
+			p->slots[i].pidfd = -1;
+		}
+	munmap(p->board, p->boardsize);
+	p->board = NULL;
+	return killed;
+}
+
+
+/***
+Stop every worker, and release the pool.
+Asks each running worker to stop, as @{drain} does, and waits up to
+*timeout* milliseconds for them to exit before killing any that remain
+with `SIGKILL`, and then reaps them all.  The pool cannot be used
+afterwards.  A pool that is garbage collected without being closed is
+closed with the default *timeout*.
+@function close
+@int[opt=5000] timeout milliseconds to wait for workers to exit
+@treturn int number of workers that had to be killed
+*/
+static int
+pf_close_method(lua_State *L)
+{
+	pf_pool *p = checksupervisor(L, 1);
+	lua_Integer timeout = optinteger(L, 2, 5000);
+	checknargs(L, 2);
+	return pushintegerresult(pf_close(p, timeout));
+}
+
+
+static int
+pf_gc(lua_State *L)
+{
+	pf_close(checkpool(L, 1), 5000);
+	return 0;
+}
+
+
+static const luaL_Reg pf_methods[] =
+{
+	{"close",	pf_close_method},
+	{"drain",	pf_drain},
+	{"reload",	pf_reload},
+	{"report",	pf_report},
+	{"run",		pf_run},
+	{"scoreboard",	pf_scoreboard},
+	{"slot",	pf_slotnum},
+	{"step",	pf_step_method},
+	{"stopping",	pf_stopping},
+	{NULL, NULL}
+};
+
+
+/***
+Functions.
+@section functions
+*/
+
+
+static const char *Spool_fields[] = {
+	"workers", "worker", "backoff", "backoff_max", "min_uptime", "stop_signal"
+};
+
+/***
+Create a prefork worker pool.
+No workers are started until the first call to @{step} or @{run}.  In
+each worker, *worker* is called with the worker slot number and the
+pool, and the worker process exits with its integer result, or `0`.  If
+*worker* raises an error, the message is written to `stderr`, and the
+worker exits with status `1`.
+@function pool
+@tparam table opts pool options
+@int opts.workers number of workers to keep running
+@func opts.worker function to run in each worker
+@int[opt=100] opts.backoff milliseconds to wait before respawning a
+  worker that exited early, doubling with each consecutive early exit
+@int[opt=30000] opts.backoff_max maximum respawn delay in milliseconds
+@int[opt=1000] opts.min_uptime milliseconds a worker must run for not to
+  count as exiting early
+@int[opt=SIGTERM] opts.stop_signal signal sent by @{reload} and
+  @{drain}, or `0` to rely on workers checking @{stopping}
+@return[1] a prefork pool, with methods @{close}, @{drain}, @{reload},
+  @{report}, @{run}, @{scoreboard}, @{slot}, @{step} and @{stopping}
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@usage
+  local prefork = require "posix.prefork"
+  local pool = prefork.pool {
+    workers = 4,
+    worker = function(slot, pool)
+      while not pool:stopping() do
+        local conn = socket.accept(listener)
+        pool:report("busy")
+        handle(conn)
+        pool:report("idle", 1)
+      end
+    end,
+    stop_signal = 0,
+  }
+  pool:run(check_signals)
+*/
+static int
+Ppool(lua_State *L)
+{
+	pf_pool *p;
+	void *board;
+	lua_Integer workers, backoff, backoff_max, min_uptime;
+	size_t size;
+	int i, stopsig;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	checkfieldnames(L, 1, Spool_fields);
+	checknargs(L, 1);
+	workers = checkintegerfield(L, 1, "workers");
+	luaL_argcheck(L, workers > 0 && workers <= 65536, 1,
+		"workers must be between 1 and 65536");
+	checkfieldtype(L, 1, "worker", LUA_TFUNCTION, "function");
+	lua_pop(L, 1);
+	backoff = optintegerfield(L, 1, "backoff", 100);
+	backoff_max = optintegerfield(L, 1, "backoff_max", 30000);
+	min_uptime = optintegerfield(L, 1, "min_uptime", 1000);
+	stopsig = optintfield(L, 1, "stop_signal", SIGTERM);
+
+	/* Make the userdata safe to collect before mapping the scoreboard,
+	   so that a memory error cannot leak the mapping. */
+	size = offsetof(pf_pool, slots) + workers * sizeof *p->slots;
+	p = (pf_pool *)lua_newuserdata(L, size);
+	memset(p, 0, size);
+	p->nslots = (int)workers;
+	p->self = -1;
+	p->owner = getpid();
+	for (i = 0; i < p->nslots; i++)
+		p->slots[i].pidfd = -1;
+	if (luaL_newmetatable(L, PREFORK_HANDLE))
+	{
+		luaL_newlib(L, pf_methods);
+		lua_setfield(L, -2, "__index");
+		lua_pushcfunction(L, pf_gc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_setmetatable(L, -2);
+
+	p->boardsize = workers * sizeof *p->board;
+	board = mmap(NULL, p->boardsize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (board == MAP_FAILED)
+		return pusherror(L, "mmap");
+	memset(board, 0, p->boardsize);
+	p->board = (pf_score *)board;
+	p->backoff = backoff < 1 ? 1 : backoff;
+	p->backoff_max = backoff_max;
+	p->min_uptime = min_uptime;
+	p->stopsig = stopsig;
+
+	/* The worker function lives in the uservalue table. */
+	lua_createtable(L, 1, 0);
+	lua_getfield(L, 1, "worker");
+	lua_rawseti(L, -2, 1);
+	lua_setuservalue(L, -2);
+	return 1;
+}
+
+
+static const luaL_Reg posix_prefork_fns[] =
+{
+	LPOSIX_FUNC( Ppool		),
+	{NULL, NULL}
+};
+
+
+LUALIB_API int
+luaopen_posix_prefork(lua_State *L)
+{
+	luaL_newlib(L, posix_prefork_fns);
+	lua_pushstring(L, LPOSIX_VERSION_STRING("prefork"));
+	lua_setfield(L, -2, "version");
+
+	return 1;
+}
@@ -13,12 +13,15 @@
  Kernel Thread Scheduling Priority.
 
  Where supported by the underlying system, functions to discover and
- change the kernel thread scheduling priority.  If the module loads
- successfully, but there is no kernel support, then `posix.sched.version`
- will be set, but the unsupported APIs will be `nil`.
+ change the kernel thread scheduling priority, and the set of CPUs a
+ thread may run on.  If the module loads successfully, but there is no
+ kernel support, then `posix.sched.version` will be set, but the
+ unsupported APIs will be `nil`.
 @module posix.sched
 */
 
+#include "_helpers.c"	/* for _GNU_SOURCE, needed by CPU_ALLOC */
+
 /* cannot use unistd.h for _POSIX_PRIORITY_SCHEDULING, because on Linux
    glibc it is defined even though the APIs are not implemented :-(     */
 
@@ -26,7 +29,14 @@
 #include <sched.h>
 #endif
 
-#include "_helpers.c"
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
 
 
 /***
@@ -80,6 +90,672 @@ Psched_setscheduler(lua_State *L)
 #endif
 
 
+#if HAVE_SCHED_SETAFFINITY
+/* Cpu sets are sized for every configured CPU, and never fewer than
+   CPU_SETSIZE, so that sets from this process are all the same size. */
+#define CPUSET_HANDLE	PACKAGE " cpu set"
+
+typedef struct
+{
+	size_t		setsize;	/* bytes in set, for the CPU_*_S macros */
+	int		ncpus;		/* capacity in CPUs */
+	cpu_set_t	set[1];		/* actually setsize bytes long */
+} cpuset;
+
+
+static cpuset *
+checkcpuset(lua_State *L, int narg)
+{
+	return (cpuset *)luaL_checkudata(L, narg, CPUSET_HANDLE);
+}
+
+
+static int
+checkcpu(lua_State *L, int narg, cpuset *cs)
+{
+	lua_Integer cpu = checkinteger(L, narg);
+	luaL_argcheck(L, cpu >= 0 && cpu < cs->ncpus, narg, "cpu out of range");
+	return (int)cpu;
+}
+
+
+/* Push a new, empty cpu set. */
+static cpuset *
+newcpuset(lua_State *L)
+{
+	long conf = sysconf(_SC_NPROCESSORS_CONF);
+	int ncpus = conf > CPU_SETSIZE ? (int)conf : CPU_SETSIZE;
+	size_t setsize = CPU_ALLOC_SIZE(ncpus);
+	cpuset *cs = (cpuset *)lua_newuserdata(L, offsetof(cpuset, set) + setsize);
+
+	cs->setsize = setsize;
+	cs->ncpus = (int)(setsize * 8);
+	CPU_ZERO_S(setsize, cs->set);
+	luaL_getmetatable(L, CPUSET_HANDLE);
+	lua_setmetatable(L, -2);
+	return cs;
+}
+
+
+/* Parse a cpu list such as "0-3,8" into *cs*, returning 0 on success.
+   Unlike strtol, accept nothing but digits, '-' and ',' separators. */
+static int
+parsecpulist(cpuset *cs, const char *s)
+{
+	while (*s)
+	{
+		char *end;
+		long lo, hi;
+		if (!isdigit((unsigned char)*s))
+			return -1;
+		hi = lo = strtol(s, &end, 10);
+		if (*end == '-')
+		{
+			s = end + 1;
+			if (!isdigit((unsigned char)*s))
+				return -1;
+			hi = strtol(s, &end, 10);
+			if (hi < lo)
+				return -1;
+		}
+		if (hi >= cs->ncpus)
+			return -1;
+		for (; lo <= hi; lo++)
+			CPU_SET_S(lo, cs->setsize, cs->set);
+		if (*end == ',' && end[1] != '\0')
+			end++;
+		else if (*end != '\0')
+			return -1;
+		s = end;
+	}
+	return 0;
+}
+
+
+/* Return the cpu set at *narg*, or else push a new one built from a list
+   of cpu numbers or a cpu list string such as "0-3,8".  Call this after
+   any other argument checks, because it may push onto the stack. */
+static cpuset *
+tocpuset(lua_State *L, int narg)
+{
+	cpuset *cs;
+	int i, n;
+
+	switch (lua_type(L, narg))
+	{
+		case LUA_TTABLE:
+			cs = newcpuset(L);
+			n = (int)lua_objlen(L, narg);
+			for (i = 1; i <= n; i++)
+			{
+				lua_Integer cpu;
+				int isint = 0;
+				lua_rawgeti(L, narg, i);
+				cpu = lua_tointegerx(L, -1, &isint);
+				if (!isint || lua_type(L, -1) != LUA_TNUMBER
+				    || (lua_Number)cpu != lua_tonumber(L, -1))
+					luaL_argerror(L, narg, "integer cpu numbers expected");
+				if (cpu < 0 || cpu >= cs->ncpus)
+					luaL_argerror(L, narg, "cpu number out of range");
+				lua_pop(L, 1);
+				CPU_SET_S(cpu, cs->setsize, cs->set);
+			}
+			return cs;
+		case LUA_TSTRING:
+			cs = newcpuset(L);
+			if (parsecpulist(cs, lua_tostring(L, narg)) == -1)
+				luaL_argerror(L, narg, "malformed cpu list");
+			return cs;
+		case LUA_TUSERDATA:
+			return checkcpuset(L, narg);
+	}
+	argtypeerror(L, narg, "PosixCpuSet, table or string");
+	return NULL;
+}
+
+
+/***
+Cpu Set Methods.
+A cpu set, as returned by @{sched_getaffinity} and @{cpuset}, is a set
+of cpu numbers.  The length operator returns @{count}, `==` compares
+membership, and `tostring` returns a cpu list such as `"0-3,8"`.
+@section methods
+*/
+
+
+/***
+Add cpus to the set.
+@function set
+@int cpu cpu number
+@int[opt] ... more cpu numbers
+@return the set, for chaining
+@usage local cpus = sched.cpuset():set(0, 2)
+*/
+static int
+cpuset_set(lua_State *L)
+{
+	cpuset *cs = checkcpuset(L, 1);
+	int i, n = lua_gettop(L);
+	for (i = 2; i <= n; i++)
+		CPU_SET_S(checkcpu(L, i, cs), cs->setsize, cs->set);
+	lua_settop(L, 1);
+	return 1;
+}
+
+
+/***
+Remove cpus from the set.
+@function clear
+@int[opt] cpu cpu number, or all cpus if omitted
+@int[opt] ... more cpu numbers
+@return the set, for chaining
+*/
+static int
+cpuset_clear(lua_State *L)
+{
+	cpuset *cs = checkcpuset(L, 1);
+	int i, n = lua_gettop(L);
+	if (n < 2)
+		CPU_ZERO_S(cs->setsize, cs->set);
+	for (i = 2; i <= n; i++)
+		CPU_CLR_S(checkcpu(L, i, cs), cs->setsize, cs->set);
+	lua_settop(L, 1);
+	return 1;
+}
+
+
+/***
+Test whether a cpu is in the set.
+@function isset
+@int cpu cpu number
+@treturn boolean `true` if *cpu* is a member, otherwise `false`
+*/
+static int
+cpuset_isset(lua_State *L)
+{
+	cpuset *cs = checkcpuset(L, 1);
+	lua_Integer cpu = checkinteger(L, 2);
+	checknargs(L, 2);
+	return pushboolresult(cpu >= 0 && cpu < cs->ncpus &&
+		CPU_ISSET_S(cpu, cs->setsize, cs->set));
+}
+
+
+/***
+Count the cpus in the set.
+@function count
+@treturn int number of member cpus
+*/
+static int
+cpuset_count(lua_State *L)
+{
+	cpuset *cs = checkcpuset(L, 1);
+	return pushintegerresult(CPU_COUNT_S(cs->setsize, cs->set));
+}
+
+
+/* All cpu sets have the same size, so the CPU_*_S macros can combine
+   them directly. */
+#define CPUSET_OP(_n, _op)						\
+static int								\
+_n(lua_State *L)							\
+{									\
+	cpuset *a = checkcpuset(L, 1), *b, *r;				\
+	checknargs(L, 2);						\
+	b = tocpuset(L, 2);						\
+	r = newcpuset(L);						\
+	_op(r->setsize, r->set, a->set, b->set);			\
+	return 1;							\
+}
+
+/***
+Return a new set with the cpus in either set.
+@function union
+@tparam cpuset|table|string other another set, a list of cpu
+  numbers, or a cpu list string
+@return a new set
+*/
+CPUSET_OP(cpuset_union,		CPU_OR_S)
+
+/***
+Return a new set with the cpus in both sets.
+@function intersection
+@tparam cpuset|table|string other another set, a list of cpu
+  numbers, or a cpu list string
+@return a new set
+*/
+CPUSET_OP(cpuset_intersection,	CPU_AND_S)
+
+/***
+Return a new set with the cpus in this set but not in *other*.
+@function difference
+@tparam cpuset|table|string other another set, a list of cpu
+  numbers, or a cpu list string
+@return a new set
+*/
+static int
+cpuset_difference(lua_State *L)
+{
+	cpuset *a = checkcpuset(L, 1), *b, *r;
+	size_t i;
+	checknargs(L, 2);
+	b = tocpuset(L, 2);
+	r = newcpuset(L);
+	/* cpu_set_t has no public and-not operation, so go byte-wise. */
+	for (i = 0; i < r->setsize; i++)
+		((unsigned char *)r->set)[i] =
+			((unsigned char *)a->set)[i] & ~((unsigned char *)b->set)[i];
+	return 1;
+}
+
+
+static int
+cpuset_cpus_iter(lua_State *L)
+{
+	cpuset *cs = checkcpuset(L, 1);
+	int cpu = (int)lua_tointeger(L, 2);
+	while (++cpu < cs->ncpus)
+		if (CPU_ISSET_S(cpu, cs->setsize, cs->set))
+			return pushintegerresult(cpu);
+	return 0;
+}
+
+
+/***
+Iterate over the cpus in the set, in ascending order.
+@function cpus
+@return an iterator function, for use with `for`
+@usage
+  for cpu in sched.sched_getaffinity():cpus() do print(cpu) end
+*/
+static int
+cpuset_cpus(lua_State *L)
+{
+	checkcpuset(L, 1);
+	checknargs(L, 1);
+	lua_pushcfunction(L, cpuset_cpus_iter);
+	lua_pushvalue(L, 1);
+	lua_pushinteger(L, -1);
+	return 3;
+}
+
+
+static int
+cpuset_eq(lua_State *L)
+{
+	cpuset *a = checkcpuset(L, 1), *b = checkcpuset(L, 2);
+	return pushboolresult(CPU_EQUAL_S(a->setsize, a->set, b->set));
+}
+
+
+static int
+cpuset_tostring(lua_State *L)
+{
+	cpuset *cs = checkcpuset(L, 1);
+	luaL_Buffer b;
+	int cpu, lo, sep = 0;
+
+	luaL_buffinit(L, &b);
+	for (cpu = 0; cpu < cs->ncpus; cpu++)
+	{
+		if (!CPU_ISSET_S(cpu, cs->setsize, cs->set))
+			continue;
+		for (lo = cpu; cpu + 1 < cs->ncpus &&
+			CPU_ISSET_S(cpu + 1, cs->setsize, cs->set); cpu++)
+			;
+		if (sep++)
+			luaL_addchar(&b, ',');
+		lua_pushinteger(L, lo);
+		luaL_addvalue(&b);
+		if (cpu > lo)
+		{
+			luaL_addchar(&b, '-');
+			lua_pushinteger(L, cpu);
+			luaL_addvalue(&b);
+		}
+	}
+	luaL_pushresult(&b);
+	return 1;
+}
+
+
+static const luaL_Reg cpuset_methods[] =
+{
+	{"clear",		cpuset_clear},
+	{"count",		cpuset_count},
+	{"cpus",		cpuset_cpus},
+	{"difference",		cpuset_difference},
+	{"intersection",	cpuset_intersection},
+	{"isset",		cpuset_isset},
+	{"set",			cpuset_set},
+	{"union",		cpuset_union},
+	{NULL, NULL}
+};
+
+
+/***
+Functions.
+@section functions
+*/
+
+
+/***
+Create a cpu set.
+@function cpuset
+@tparam[opt] table|string cpus list of cpu numbers, or a cpu list
+  string such as `"0-3,8"`
+@return a new set containing *cpus*
+@usage
+  local sched = require "posix.sched"
+  sched.sched_setaffinity(0, sched.cpuset "0-3")
+*/
+static int
+Pcpuset(lua_State *L)
+{
+	checknargs(L, 1);
+	if (lua_isnoneornil(L, 1))
+	{
+		newcpuset(L);
+		return 1;
+	}
+	if (lua_isuserdata(L, 1))
+		argtypeerror(L, 1, "table, string or nil");
+	tocpuset(L, 1);
+	return 1;
+}
+
+
+/***
+Get the set of cpus a process may run on.
+@function sched_getaffinity
+@int[opt=0] pid process to act on, or `0` for caller process
+@return[1] cpu set of cpus *pid* may run on, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see sched_getaffinity(2)
+@usage
+  local sched = require "posix.sched"
+  print(#sched.sched_getaffinity(), "cpus available")
+*/
+static int
+Psched_getaffinity(lua_State *L)
+{
+	pid_t pid = (pid_t)optinteger(L, 1, 0);
+	cpuset *cs;
+	checknargs(L, 1);
+	cs = newcpuset(L);
+	if (sched_getaffinity(pid, cs->setsize, cs->set) == -1)
+		return pusherror(L, NULL);
+	return 1;
+}
+
+
+/***
+Restrict a process to run on a set of cpus.
+Pinning each worker process to its own cpu keeps its caches warm, and
+stops the kernel migrating it between sockets under load.
+@function sched_setaffinity
+@int pid process to act on, or `0` for caller process
+@tparam cpuset|table|string cpus set of cpus, list of cpu numbers,
+  or cpu list string
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see sched_setaffinity(2)
+@usage
+  local sched = require "posix.sched"
+  -- pin worker i to one of the cpus we were started with
+  local cpus = {}
+  for cpu in sched.sched_getaffinity():cpus() do cpus[#cpus + 1] = cpu end
+  sched.sched_setaffinity(0, {cpus[i % #cpus + 1]})
+*/
+static int
+Psched_setaffinity(lua_State *L)
+{
+	pid_t pid = (pid_t)checkinteger(L, 1);
+	cpuset *cs;
+	checknargs(L, 2);
+	cs = tocpuset(L, 2);
+	return pushresult(L, sched_setaffinity(pid, cs->setsize, cs->set), NULL);
+}
+#endif
+
+
+#if HAVE_SCHED_GETCPU
+/***
+Get the cpu the calling thread is running on.
+The result may be stale as soon as it is returned, unless the thread is
+pinned with @{sched_setaffinity}.
+@function sched_getcpu
+@treturn[1] int cpu number, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see sched_getcpu(3)
+*/
+static int
+Psched_getcpu(lua_State *L)
+{
+	checknargs(L, 0);
+	return pushresult(L, sched_getcpu(), NULL);
+}
+#endif
+
+
+#if HAVE_SCHED_YIELD
+/***
+Relinquish the cpu.
+@function sched_yield
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see sched_yield(2)
+*/
+static int
+Psched_yield(lua_State *L)
+{
+	checknargs(L, 0);
+	return pushresult(L, sched_yield(), NULL);
+}
+#endif
+
+
+#if HAVE_SCHED_GET_PRIORITY_MAX
+/***
+Get the highest priority for a scheduling policy.
+@function sched_get_priority_max
+@int policy one of `SCHED_FIFO`, `SCHED_RR`, `SCHED_OTHER`, `SCHED_BATCH`,
+  `SCHED_IDLE` or `SCHED_DEADLINE`
+@treturn[1] int maximum priority, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see sched_get_priority_max(2)
+*/
+static int
+Psched_get_priority_max(lua_State *L)
+{
+	int policy = checkint(L, 1);
+	checknargs(L, 1);
+	return pushresult(L, sched_get_priority_max(policy), NULL);
+}
+
+
+/***
+Get the lowest priority for a scheduling policy.
+@function sched_get_priority_min
+@int policy one of `SCHED_FIFO`, `SCHED_RR`, `SCHED_OTHER`, `SCHED_BATCH`,
+  `SCHED_IDLE` or `SCHED_DEADLINE`
+@treturn[1] int minimum priority, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see sched_get_priority_min(2)
+*/
+static int
+Psched_get_priority_min(lua_State *L)
+{
+	int policy = checkint(L, 1);
+	checknargs(L, 1);
+	return pushresult(L, sched_get_priority_min(policy), NULL);
+}
+#endif
+
+
+#if HAVE_SCHED_H && HAVE_SYS_SYSCALL_H && defined SYS_sched_setattr
+/* libc does not reliably declare struct sched_attr or wrap the system
+   calls, so use the kernel ABI directly.  The kernel accepts a larger
+   struct than it knows about, provided the extra fields are zero. */
+struct lsched_attr
+{
+	uint32_t	size;
+	uint32_t	sched_policy;
+	uint64_t	sched_flags;
+	int32_t		sched_nice;
+	uint32_t	sched_priority;
+	uint64_t	sched_runtime;
+	uint64_t	sched_deadline;
+	uint64_t	sched_period;
+	uint32_t	sched_util_min;
+	uint32_t	sched_util_max;
+};
+
+#ifndef SCHED_FLAG_RESET_ON_FORK
+#  define SCHED_FLAG_RESET_ON_FORK	0x01
+#endif
+#ifndef SCHED_FLAG_RECLAIM
+#  define SCHED_FLAG_RECLAIM		0x02
+#endif
+#ifndef SCHED_FLAG_DL_OVERRUN
+#  define SCHED_FLAG_DL_OVERRUN		0x04
+#endif
+#ifndef SCHED_FLAG_KEEP_POLICY
+#  define SCHED_FLAG_KEEP_POLICY	0x08
+#endif
+#ifndef SCHED_FLAG_KEEP_PARAMS
+#  define SCHED_FLAG_KEEP_PARAMS	0x10
+#endif
+#ifndef SCHED_FLAG_UTIL_CLAMP_MIN
+#  define SCHED_FLAG_UTIL_CLAMP_MIN	0x20
+#endif
+#ifndef SCHED_FLAG_UTIL_CLAMP_MAX
+#  define SCHED_FLAG_UTIL_CLAMP_MAX	0x40
+#endif
+
+
+/***
+Scheduling attributes.
+@table PosixSchedAttr
+@int sched_policy scheduling policy, such as `SCHED_OTHER` or
+  `SCHED_DEADLINE`
+@int sched_flags bitwise OR of zero or more `SCHED_FLAG_*` constants
+@int sched_nice nice value, for `SCHED_OTHER` and `SCHED_BATCH`
+@int sched_priority static priority, for `SCHED_FIFO` and `SCHED_RR`
+@int sched_runtime cpu time per period in nanoseconds, for `SCHED_DEADLINE`
+@int sched_deadline relative deadline in nanoseconds, for `SCHED_DEADLINE`
+@int sched_period period in nanoseconds, for `SCHED_DEADLINE`
+@int sched_util_min utilization clamp minimum, from `0` to `1024`, with
+  `SCHED_FLAG_UTIL_CLAMP_MIN`
+@int sched_util_max utilization clamp maximum, from `0` to `1024`, with
+  `SCHED_FLAG_UTIL_CLAMP_MAX`
+*/
+static const char *Ssched_attr_fields[] = {
+	"sched_policy", "sched_flags", "sched_nice", "sched_priority",
+	"sched_runtime", "sched_deadline", "sched_period",
+	"sched_util_min", "sched_util_max"
+};
+
+
+/***
+Get the scheduling attributes of a thread.
+@function sched_getattr
+@int[opt=0] pid thread to act on, or `0` for caller thread
+@treturn[1] PosixSchedAttr scheduling attributes, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see sched_getattr(2)
+*/
+static int
+Psched_getattr(lua_State *L)
+{
+	struct lsched_attr attr;
+	struct lsched_attr *a = &attr;
+	pid_t pid = (pid_t)optinteger(L, 1, 0);
+	checknargs(L, 1);
+
+	memset(a, 0, sizeof *a);
+	if (syscall(SYS_sched_getattr, pid, a, (unsigned)sizeof *a, 0U) == -1)
+		return pusherror(L, NULL);
+
+	lua_createtable(L, 0, 9);
+	setintegerfield(a, sched_policy);
+	setintegerfield(a, sched_flags);
+	setintegerfield(a, sched_nice);
+	setintegerfield(a, sched_priority);
+	setintegerfield(a, sched_runtime);
+	setintegerfield(a, sched_deadline);
+	setintegerfield(a, sched_period);
+	setintegerfield(a, sched_util_min);
+	setintegerfield(a, sched_util_max);
+	settypemetatable("PosixSchedAttr");
+	return 1;
+}
+
+
+/***
+Set the scheduling attributes of a thread.
+This can select policies that @{sched_setscheduler} cannot, such as
+`SCHED_DEADLINE`, where the kernel guarantees *sched_runtime*
+nanoseconds of cpu in every *sched_period* before *sched_deadline*, or
+set utilization clamps that bias cpu frequency and placement.  Omitted
+fields are `0`, except *sched_policy* which defaults to `SCHED_OTHER`.
+@function sched_setattr
+@int pid thread to act on, or `0` for caller thread
+@tparam PosixSchedAttr attr scheduling attributes
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see sched_setattr(2)
+@usage
+  local sched = require "posix.sched"
+  -- 2ms of cpu in every 10ms, finished within 5ms of each period start
+  sched.sched_setattr(0, {
+    sched_policy = sched.SCHED_DEADLINE,
+    sched_runtime = 2000000,
+    sched_deadline = 5000000,
+    sched_period = 10000000,
+  })
+*/
+static int
+Psched_setattr(lua_State *L)
+{
+	struct lsched_attr attr;
+	pid_t pid = (pid_t)checkinteger(L, 1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	checkfieldnames(L, 2, Ssched_attr_fields);
+	checknargs(L, 2);
+
+	memset(&attr, 0, sizeof attr);
+	attr.size = sizeof attr;
+	attr.sched_policy = (uint32_t)optintegerfield(L, 2, "sched_policy", SCHED_OTHER);
+	attr.sched_flags = (uint64_t)optintegerfield(L, 2, "sched_flags", 0);
+	attr.sched_nice = (int32_t)optintegerfield(L, 2, "sched_nice", 0);
+	attr.sched_priority = (uint32_t)optintegerfield(L, 2, "sched_priority", 0);
+	attr.sched_runtime = (uint64_t)optintegerfield(L, 2, "sched_runtime", 0);
+	attr.sched_deadline = (uint64_t)optintegerfield(L, 2, "sched_deadline", 0);
+	attr.sched_period = (uint64_t)optintegerfield(L, 2, "sched_period", 0);
+	attr.sched_util_min = (uint32_t)optintegerfield(L, 2, "sched_util_min", 0);
+	attr.sched_util_max = (uint32_t)optintegerfield(L, 2, "sched_util_max", 0);
+	return pushresult(L, (int)syscall(SYS_sched_setattr, pid, &attr, 0U), NULL);
+}
+#endif
+
+
 static const luaL_Reg posix_sched_fns[] =
 {
 #if HAVE_SCHED_GETSCHEDULER
@@ -87,6 +763,25 @@ static const luaL_Reg posix_sched_fns[] =
 #endif
 #if HAVE_SCHED_SETSCHEDULER
 	LPOSIX_FUNC( Psched_setscheduler	),
+#endif
+#if HAVE_SCHED_SETAFFINITY
+	LPOSIX_FUNC( Pcpuset			),
+	LPOSIX_FUNC( Psched_getaffinity		),
+	LPOSIX_FUNC( Psched_setaffinity		),
+#endif
+#if HAVE_SCHED_GETCPU
+	LPOSIX_FUNC( Psched_getcpu		),
+#endif
+#if HAVE_SCHED_GET_PRIORITY_MAX
+	LPOSIX_FUNC( Psched_get_priority_max	),
+	LPOSIX_FUNC( Psched_get_priority_min	),
+#endif
+#if HAVE_SCHED_YIELD
+	LPOSIX_FUNC( Psched_yield		),
+#endif
+#if HAVE_SCHED_H && HAVE_SYS_SYSCALL_H && defined SYS_sched_setattr
+	LPOSIX_FUNC( Psched_getattr		),
+	LPOSIX_FUNC( Psched_setattr		),
 #endif
 	{NULL, NULL}
 };
@@ -101,9 +796,23 @@ Constants.
 Scheduler constants.
 Any constants not available in the underlying system will be `nil` valued.
 @table posix.sched
+@int SCHED_BATCH non-interactive, cpu-bound scheduling policy
+@int SCHED_DEADLINE earliest deadline first scheduling policy, for
+  @{sched_setattr}
 @int SCHED_FIFO  first-in, first-out scheduling policy
-@int SCHED_RR round-robin scheduling policy
+@int SCHED_FLAG_DL_OVERRUN signal `SIGXCPU` on `SCHED_DEADLINE` overrun
+@int SCHED_FLAG_KEEP_PARAMS leave policy parameters unchanged
+@int SCHED_FLAG_KEEP_POLICY leave the scheduling policy unchanged
+@int SCHED_FLAG_RECLAIM let `SCHED_DEADLINE` threads reclaim unused
+  bandwidth
+@int SCHED_FLAG_RESET_ON_FORK children revert to `SCHED_OTHER`
+@int SCHED_FLAG_UTIL_CLAMP_MAX set *sched_util_max*
+@int SCHED_FLAG_UTIL_CLAMP_MIN set *sched_util_min*
+@int SCHED_IDLE very low priority background scheduling policy
 @int SCHED_OTHER another scheduling policy
+@int SCHED_RESET_ON_FORK bitwise OR with a policy for
+  @{sched_setscheduler}, so that children revert to `SCHED_OTHER`
+@int SCHED_RR round-robin scheduling policy
 @usage
   -- Print scheduler constants supported on this host.
   for name, value in pairs (require "posix.sched") do
@@ -130,6 +839,45 @@ luaopen_posix_sched(lua_State *L)
 #ifdef SCHED_OTHER
 	LPOSIX_CONST( SCHED_OTHER	);
 #endif
+#ifdef SCHED_BATCH
+	LPOSIX_CONST( SCHED_BATCH	);
+#endif
+#ifdef SCHED_IDLE
+	LPOSIX_CONST( SCHED_IDLE	);
+#endif
+#ifdef SCHED_DEADLINE
+	LPOSIX_CONST( SCHED_DEADLINE	);
+#endif
+#ifdef SCHED_RESET_ON_FORK
+	LPOSIX_CONST( SCHED_RESET_ON_FORK	);
+#endif
+
+	/* Psched_setattr flags */
+#if HAVE_SCHED_H && HAVE_SYS_SYSCALL_H && defined SYS_sched_setattr
+	LPOSIX_CONST( SCHED_FLAG_DL_OVERRUN	);
+	LPOSIX_CONST( SCHED_FLAG_KEEP_PARAMS	);
+	LPOSIX_CONST( SCHED_FLAG_KEEP_POLICY	);
+	LPOSIX_CONST( SCHED_FLAG_RECLAIM	);
+	LPOSIX_CONST( SCHED_FLAG_RESET_ON_FORK	);
+	LPOSIX_CONST( SCHED_FLAG_UTIL_CLAMP_MAX	);
+	LPOSIX_CONST( SCHED_FLAG_UTIL_CLAMP_MIN	);
+#endif
+
+#if HAVE_SCHED_SETAFFINITY
+	if (luaL_newmetatable(L, CPUSET_HANDLE))
+	{
+		pushliteralfield("_type", "PosixCpuSet");
+		luaL_newlib(L, cpuset_methods);
+		lua_setfield(L, -2, "__index");
+		lua_pushcfunction(L, cpuset_count);
+		lua_setfield(L, -2, "__len");
+		lua_pushcfunction(L, cpuset_eq);
+		lua_setfield(L, -2, "__eq");
+		lua_pushcfunction(L, cpuset_tostring);
+		lua_setfield(L, -2, "__tostring");
+	}
+	lua_pop(L, 1);
+#endif
 
 	return 1;
 }
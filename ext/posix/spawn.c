@@ -0,0 +1,382 @@
+/*
+ * POSIX library for Lua 5.1, 5.2, 5.3 & 5.4.
+ * Copyright (C) 2013-2025 Gary V. Vaughan
+ * Copyright (C) 2010-2013 Reuben Thomas <rrt@sc3d.org>
+ * Copyright (C) 2008-2010 Natanael Copa <natanael.copa@gmail.com>
+ * Clean up and bug fixes by Leo Razoumov <slonik.az@gmail.com> 2006-10-11
+ * Luiz Henrique de Figueiredo <lhf@tecgraf.puc-rio.br> 07 Apr 2006 23:17:49
+ * Based on original by Claudio Terra for Lua 3.x.
+ * With contributions by Roberto Ierusalimschy.
+ * With documentation from Steve Donovan 2012
+ */
+/***
+ Spawn Process Pipelines.
+
+ Start every stage of a command pipeline directly with `posix_spawnp`,
+ without forking a copy of the Lua interpreter per stage, in the manner
+ of a shell running `cmd1 | cmd2 | cmd3`.
+
+@module posix.spawn
+*/
+
+#include "_helpers.c"	/* for _GNU_SOURCE, needed by F_SETPIPE_SZ */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+
+/* Create a pipe whose ends are both close-on-exec, so that each stage
+   only inherits the ends that are dup2'd onto its stdin and stdout. */
+static int
+cloexecpipe(int fds[2], lua_Integer pipe_size)
+{
+#if HAVE_PIPE2
+	if (pipe2(fds, O_CLOEXEC) == -1)
+		return -1;
+#else
+	if (pipe(fds) == -1)
+		return -1;
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+#ifdef F_SETPIPE_SZ
+	/* Best effort: unprivileged processes are capped by pipe-max-size. */
+	if (pipe_size > 0)
+		fcntl(fds[1], F_SETPIPE_SZ, (int)pipe_size);
+#else
+	(void)pipe_size;
+#endif
+	return 0;
+}
+
+
+/* Return a NULL terminated argv for task *i* of the list at *tasks*,
+   allocated as a userdata pushed onto the stack.  Numeric arguments are
+   converted to strings stored after the argv pointers. */
+static char **
+checkargv(lua_State *L, int tasks, int i)
+{
+	char **argv, *buf;
+	size_t len, size;
+	int j, n;
+
+	lua_rawgeti(L, tasks, i);
+	if (lua_type(L, -1) != LUA_TTABLE || (n = (int)lua_objlen(L, -1)) == 0)
+		luaL_argerror(L, tasks, lua_pushfstring(L,
+			"non-empty list of strings expected for task %d", i));
+	size = (n + 1) * sizeof *argv;
+	for (j = 0; j < n; j++)
+	{
+		lua_rawgeti(L, -1, j + 1);
+		if (!lua_isstring(L, -1))
+			luaL_argerror(L, tasks, lua_pushfstring(L,
+				"string expected for task %d argument %d", i, j + 1));
+		if (lua_type(L, -1) != LUA_TSTRING)
+		{
+			lua_tolstring(L, -1, &len);
+			size += len + 1;
+		}
+		lua_pop(L, 1);
+	}
+	argv = (char **)lua_newuserdata(L, size);
+	buf = (char *)(argv + n + 1);
+	for (j = 0; j < n; j++)
+	{
+		lua_rawgeti(L, -2, j + 1);
+		if (lua_type(L, -1) == LUA_TSTRING)
+			/* Still referenced from the task table, so stays valid. */
+			argv[j] = (char *)lua_tostring(L, -1);
+		else
+		{
+			const char *s = lua_tolstring(L, -1, &len);
+			argv[j] = memcpy(buf, s, len + 1);
+			buf += len + 1;
+		}
+		lua_pop(L, 1);
+	}
+	argv[n] = NULL;
+	lua_remove(L, -2);
+	return argv;
+}
+
+
+/* Kill and reap the first *n* stages of a pipeline that failed to
+   start. */
+static void
+killstages(pid_t *pids, int n)
+{
+	int i;
+	for (i = 0; i < n; i++)
+		kill(pids[i], SIGKILL);
+	for (i = 0; i < n; i++)
+		while (waitpid(pids[i], NULL, 0) == -1 && errno == EINTR)
+			;
+}
+
+
+/***
+Pipeline object.
+@table PosixPipeline
+@tfield table pids process ids of each stage, in pipeline order
+@int[opt] fd caller's end of the pipeline, for *mode* `"r"` or `"w"`
+*/
+
+static const char *Spipeline_fields[] = { "pipe_size" };
+
+/***
+Start a command pipeline.
+Each stage's standard output is connected to the standard input of the
+next stage.  With *mode* `"r"`, the caller reads the standard output of
+the last stage from the returned *fd*, and with *mode* `"w"` writes the
+standard input of the first stage to it.  Otherwise, the first stage
+inherits the caller's standard input, and the last stage the caller's
+standard output.  Every pipe end is close-on-exec, so no stage inherits
+the ends of pipes that it doesn't use.
+
+If any stage cannot be started, such as when the command is not found,
+the stages already started are killed and reaped before returning the
+error.
+
+The result can be passed to @{posix.pclose}, or to @{pipeline_wait}
+to collect the status of every stage.
+@function pipeline
+@tparam table tasks list of argument lists, each starting with the
+  command to run, which is looked up in `PATH`
+@string[opt] mode `"r"` for read, `"w"` for write, or `nil`
+@tparam[opt] table opts options
+@int[opt] opts.pipe_size where supported, try to set the capacity of
+  each pipe to at least this many bytes with `F_SETPIPE_SZ`
+@treturn[1] PosixPipeline pipeline object, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see posix_spawn(3)
+@usage
+  local spawn = require "posix.spawn"
+  local p = spawn.pipeline({{"zcat", "app.log.gz"}, {"grep", "ERROR"},
+    {"sort"}, {"uniq", "-c"}}, "r", {pipe_size = 1048576})
+  local out = require "posix.unistd".read(p.fd, 65536)
+  local reason, status, stages = spawn.pipeline_wait(p)
+*/
+static int
+Ppipeline(lua_State *L)
+{
+	const char *mode;
+	lua_Integer pipe_size = 0;
+	posix_spawn_file_actions_t fa;
+	pid_t *pids;
+	int *fds, n, i, r = 0, nfds, parentfd = -1, prevfd = -1;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	mode = optstring(L, 2, NULL);
+	if (!lua_isnoneornil(L, 3))
+	{
+		luaL_checktype(L, 3, LUA_TTABLE);
+		checkfieldnames(L, 3, Spipeline_fields);
+		pipe_size = optintegerfield(L, 3, "pipe_size", 0);
+	}
+	checknargs(L, 3);
+	if (mode != NULL && !STREQ(mode, "r") && !STREQ(mode, "w"))
+		luaL_argerror(L, 2, "invalid mode");
+	n = (int)lua_objlen(L, 1);
+	luaL_argcheck(L, n > 0, 1, "no tasks");
+
+	/* Validate every task before starting any of them. */
+	for (i = 1; i <= n; i++)
+		checkargv(L, 1, i);
+	lua_settop(L, 3);
+
+	pids = (pid_t *)lua_newuserdata(L, n * sizeof *pids);
+	fds = (int *)lua_newuserdata(L, 2 * (n + 1) * sizeof *fds);
+	nfds = 0;
+
+	/* Parent's end of the pipe to the first or last stage. */
+	if (mode != NULL)
+	{
+		int pfd[2];
+		if (cloexecpipe(pfd, pipe_size) == -1)
+			return pusherror(L, "pipe");
+		fds[nfds++] = pfd[0];
+		fds[nfds++] = pfd[1];
+		if (*mode == 'w')
+		{
+			parentfd = pfd[1];
+			prevfd = pfd[0];
+		}
+		else
+			parentfd = pfd[0];
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		char **argv;
+		int outfd = -1;
+
+		if (i < n - 1)
+		{
+			int pfd[2];
+			if (cloexecpipe(pfd, pipe_size) == -1)
+			{
+				r = errno;
+				break;
+			}
+			fds[nfds++] = pfd[0];
+			fds[nfds++] = pfd[1];
+			outfd = pfd[1];
+		}
+		else if (mode != NULL && *mode == 'r')
+			outfd = fds[1];
+
+		argv = checkargv(L, 1, i + 1);
+		if ((r = posix_spawn_file_actions_init(&fa)) != 0)
+		{
+			lua_pop(L, 1);
+			break;
+		}
+		if (prevfd != -1)
+			r = posix_spawn_file_actions_adddup2(&fa, prevfd, STDIN_FILENO);
+		if (r == 0 && outfd != -1)
+			r = posix_spawn_file_actions_adddup2(&fa, outfd, STDOUT_FILENO);
+		if (r == 0)
+			r = posix_spawnp(&pids[i], argv[0], &fa, NULL, argv, environ);
+		posix_spawn_file_actions_destroy(&fa);
+		lua_pop(L, 1);
+		if (r != 0)
+			break;
+
+		if (i < n - 1)
+			prevfd = fds[nfds - 2];
+	}
+
+	/* Close every pipe end, except the caller's. */
+	for (nfds--; nfds >= 0; nfds--)
+		if (fds[nfds] != parentfd || r != 0)
+			close(fds[nfds]);
+
+	if (r != 0)
+	{
+		killstages(pids, i);
+		errno = r;
+		lua_rawgeti(L, 1, i + 1);
+		lua_rawgeti(L, -1, 1);
+		return pusherror(L, lua_tostring(L, -1));
+	}
+
+	lua_createtable(L, 0, 2);
+	lua_createtable(L, n, 0);
+	for (i = 0; i < n; i++)
+	{
+		lua_pushinteger(L, pids[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+	lua_setfield(L, -2, "pids");
+	if (parentfd != -1)
+		pushintegerfield("fd", parentfd);
+	settypemetatable("PosixPipeline");
+	return 1;
+}
+
+
+/***
+Wait for every stage of a pipeline to exit.
+Closes the pipeline's *fd*, if any, and then reaps each stage in turn,
+like `PIPESTATUS` in bash.
+@function pipeline_wait
+@tparam PosixPipeline p pipeline object returned by @{pipeline}
+@treturn[1] string "exited" or "killed", for the last stage
+@treturn[1] int exit status, or signal number responsible for "killed",
+  for the last stage
+@treturn[1] table list of per-stage results, in pipeline order, each a
+  table with fields *pid*, *reason* and *status*
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@usage
+  local _, _, stages = spawn.pipeline_wait(p)
+  for i, stage in ipairs(stages) do
+    if stage.status ~= 0 then print("stage " .. i .. " failed") end
+  end
+*/
+static int
+Ppipeline_wait(lua_State *L)
+{
+	int i, n, status = 0, err = 0;
+	luaL_checktype(L, 1, LUA_TTABLE);
+	checknargs(L, 1);
+	checkfieldtype(L, 1, "pids", LUA_TTABLE, "table");
+	n = (int)lua_objlen(L, -1);
+	luaL_argcheck(L, n > 0, 1, "no pids");
+
+	lua_getfield(L, 1, "fd");
+	if (lua_isnumber(L, -1))
+	{
+		close((int)lua_tointeger(L, -1));
+		lua_pushnil(L);
+		lua_setfield(L, 1, "fd");
+	}
+	lua_pop(L, 1);
+
+	lua_createtable(L, n, 0);
+	for (i = 1; i <= n; i++)
+	{
+		pid_t pid, r;
+		lua_rawgeti(L, -2, i);
+		pid = (pid_t)lua_tointeger(L, -1);
+		lua_pop(L, 1);
+
+		while ((r = waitpid(pid, &status, 0)) == -1 && errno == EINTR)
+			;
+		if (r == -1)
+		{
+			err = errno;
+			continue;
+		}
+		lua_createtable(L, 0, 3);
+		pushintegerfield("pid", pid);
+		if (WIFSIGNALED(status))
+		{
+			pushliteralfield("reason", "killed");
+			pushintegerfield("status", WTERMSIG(status));
+		}
+		else
+		{
+			pushliteralfield("reason", "exited");
+			pushintegerfield("status", WEXITSTATUS(status));
+		}
+		lua_rawseti(L, -2, i);
+	}
+	if (err != 0)
+	{
+		errno = err;
+		return pusherror(L, "waitpid");
+	}
+
+	lua_rawgeti(L, -1, n);
+	lua_getfield(L, -1, "reason");
+	lua_getfield(L, -2, "status");
+	lua_pushvalue(L, -4);
+	return 3;
+}
+
+
+static const luaL_Reg posix_spawn_fns[] =
+{
+	LPOSIX_FUNC( Ppipeline		),
+	LPOSIX_FUNC( Ppipeline_wait	),
+	{NULL, NULL}
+};
+
+
+LUALIB_API int
+luaopen_posix_spawn(lua_State *L)
+{
+	luaL_newlib(L, posix_spawn_fns);
+	lua_pushstring(L, LPOSIX_VERSION_STRING("spawn"));
+	lua_setfield(L, -2, "version");
+
+	return 1;
+}
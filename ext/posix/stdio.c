@@ -15,9 +15,10 @@
 @module posix.stdio
 */
 
-#include <stdio.h>
+#include "_helpers.c"	/* for _GNU_SOURCE, needed by renameat2 */
 
-#include "_helpers.c"
+#include <stdio.h>
+#include <fcntl.h>
 
 /***
 Name of controlling terminal.
@@ -141,12 +142,74 @@ Prename(lua_State *L)	/** rename(oldpath, newpath) */
 }
 
 
+/***
+Change the name or location of a file, relative to directory descriptors.
+@function renameat
+@int olddirfd directory file descriptor, or `posix.fcntl.AT_FDCWD`
+@string oldpath relative to *olddirfd*, unless absolute
+@int newdirfd directory file descriptor, or `posix.fcntl.AT_FDCWD`
+@string newpath relative to *newdirfd*, unless absolute
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see renameat(2)
+*/
+static int
+Prenameat(lua_State *L)
+{
+	int olddirfd = checkint(L, 1);
+	const char *oldpath = luaL_checkstring(L, 2);
+	int newdirfd = checkint(L, 3);
+	const char *newpath = luaL_checkstring(L, 4);
+	checknargs(L, 4);
+	return pushresult(L, renameat(olddirfd, oldpath, newdirfd, newpath), NULL);
+}
+
+
+#if HAVE_RENAMEAT2
+/***
+Change the name or location of a file, with additional control flags.
+Not available on all systems.
+@function renameat2
+@int olddirfd directory file descriptor, or `posix.fcntl.AT_FDCWD`
+@string oldpath relative to *olddirfd*, unless absolute
+@int newdirfd directory file descriptor, or `posix.fcntl.AT_FDCWD`
+@string newpath relative to *newdirfd*, unless absolute
+@int[opt=0] flags bitwise OR of zero or more of `RENAME_EXCHANGE`,
+  `RENAME_NOREPLACE` and `RENAME_WHITEOUT`
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see rename(2)
+@usage
+  -- atomically replace a file, without clobbering a concurrent writer
+  local ok, errmsg = P.renameat2 (AT_FDCWD, tmp, AT_FDCWD, path, P.RENAME_NOREPLACE)
+*/
+static int
+Prenameat2(lua_State *L)
+{
+	int olddirfd = checkint(L, 1);
+	const char *oldpath = luaL_checkstring(L, 2);
+	int newdirfd = checkint(L, 3);
+	const char *newpath = luaL_checkstring(L, 4);
+	unsigned int flags = (unsigned int)optinteger(L, 5, 0);
+	checknargs(L, 5);
+	return pushresult(L, renameat2(olddirfd, oldpath, newdirfd, newpath, flags), NULL);
+}
+#endif
+
 static const luaL_Reg posix_stdio_fns[] =
 {
 	LPOSIX_FUNC( Pctermid		),
 	LPOSIX_FUNC( Pfileno		),
 	LPOSIX_FUNC( Pfdopen		),
 	LPOSIX_FUNC( Prename		),
+	LPOSIX_FUNC( Prenameat		),
+#if HAVE_RENAMEAT2
+	LPOSIX_FUNC( Prenameat2	),
+#endif
 	{NULL, NULL}
 };
 
@@ -167,6 +230,9 @@ Any constants not available in the underlying system will be `nil` valued.
 @int EOF end of file
 @int FOPEN_MAX maximum number of open files
 @int FILENAME_MAX maximum length of filename
+@int RENAME_EXCHANGE atomically exchange *oldpath* and *newpath*
+@int RENAME_NOREPLACE fail if *newpath* already exists
+@int RENAME_WHITEOUT leave a whiteout object at *oldpath*
 @usage
   -- Print stdio constants supported on this host.
   for name, value in pairs (require "posix.stdio") do
@@ -193,5 +259,18 @@ luaopen_posix_stdio(lua_State *L)
 	LPOSIX_CONST( FOPEN_MAX		);
 	LPOSIX_CONST( FILENAME_MAX	);
 
+	/* renameat2 flags */
+#if HAVE_RENAMEAT2
+#  ifdef RENAME_EXCHANGE
+	LPOSIX_CONST( RENAME_EXCHANGE	);
+#  endif
+#  ifdef RENAME_NOREPLACE
+	LPOSIX_CONST( RENAME_NOREPLACE	);
+#  endif
+#  ifdef RENAME_WHITEOUT
+	LPOSIX_CONST( RENAME_WHITEOUT	);
+#  endif
+#endif
+
 	return 1;
 }
@@ -0,0 +1,147 @@
+/*
+ * POSIX library for Lua 5.1, 5.2, 5.3 & 5.4.
+ * Copyright (C) 2013-2025 Gary V. Vaughan
+ * Copyright (C) 2010-2013 Reuben Thomas <rrt@sc3d.org>
+ * Copyright (C) 2008-2010 Natanael Copa <natanael.copa@gmail.com>
+ * Clean up and bug fixes by Leo Razoumov <slonik.az@gmail.com> 2006-10-11
+ * Luiz Henrique de Figueiredo <lhf@tecgraf.puc-rio.br> 07 Apr 2006 23:17:49
+ * Based on original by Claudio Terra for Lua 3.x.
+ * With contributions by Roberto Ierusalimschy.
+ * With documentation from Steve Donovan 2012
+ */
+/***
+ Event Notification File Descriptors.
+
+ Where supported by the underlying system, functions to create and use
+ a file descriptor holding a 64-bit event counter, which can be waited
+ on with @{posix.poll.poll} alongside other descriptors.  If the module
+ loads successfully, but there is no system support, then
+ `posix.sys.eventfd.version` will be set, but the unsupported APIs will
+ be `nil`.
+
+@module posix.sys.eventfd
+*/
+
+#include "_helpers.c"
+
+#if HAVE_SYS_EVENTFD_H && HAVE_EVENTFD
+#include <sys/eventfd.h>
+
+
+/***
+Create a file descriptor for event notification.
+@function eventfd
+@int[opt=0] initval initial value of the event counter
+@int[opt=0] flags bitwise OR of zero or more of `EFD_CLOEXEC`,
+  `EFD_NONBLOCK` and `EFD_SEMAPHORE`
+@treturn[1] int new file descriptor, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see eventfd(2)
+@usage
+  local eventfd = require "posix.sys.eventfd"
+  local efd = eventfd.eventfd(0, eventfd.EFD_NONBLOCK)
+*/
+static int
+Peventfd(lua_State *L)
+{
+	unsigned int initval = (unsigned int)optinteger(L, 1, 0);
+	int flags = optint(L, 2, 0);
+	checknargs(L, 2);
+	return pushresult(L, eventfd(initval, flags), "eventfd");
+}
+
+
+/***
+Read and reset the event counter.
+With `EFD_SEMAPHORE`, decrement the counter by one instead.
+@function eventfd_read
+@int fd file descriptor returned by @{eventfd}
+@treturn[1] int value of the counter before reading, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see eventfd(2)
+*/
+static int
+Peventfd_read(lua_State *L)
+{
+	eventfd_t value;
+	int fd = checkint(L, 1);
+	checknargs(L, 1);
+	if (eventfd_read(fd, &value) == -1)
+		return pusherror(L, "eventfd_read");
+	return pushintegerresult(value);
+}
+
+
+/***
+Add to the event counter, waking any readers.
+@function eventfd_write
+@int fd file descriptor returned by @{eventfd}
+@int[opt=1] value amount to add to the counter
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see eventfd(2)
+*/
+static int
+Peventfd_write(lua_State *L)
+{
+	int fd = checkint(L, 1);
+	eventfd_t value = (eventfd_t)optinteger(L, 2, 1);
+	checknargs(L, 2);
+	return pushresult(L, eventfd_write(fd, value), "eventfd_write");
+}
+#endif
+
+
+static const luaL_Reg posix_sys_eventfd_fns[] =
+{
+#if HAVE_SYS_EVENTFD_H && HAVE_EVENTFD
+	LPOSIX_FUNC( Peventfd		),
+	LPOSIX_FUNC( Peventfd_read	),
+	LPOSIX_FUNC( Peventfd_write	),
+#endif
+	{NULL, NULL}
+};
+
+
+/***
+Constants.
+@section constants
+*/
+
+/***
+Eventfd constants.
+Any constants not available in the underlying system will be `nil` valued.
+@table posix.sys.eventfd
+@int EFD_CLOEXEC close the new file descriptor on exec
+@int EFD_NONBLOCK reads fail with `EAGAIN` instead of blocking when the counter is zero
+@int EFD_SEMAPHORE reads decrement the counter by one instead of resetting it
+@usage
+  -- Print eventfd constants supported on this host.
+  for name, value in pairs (require "posix.sys.eventfd") do
+    if type (value) == "number" then
+      print (name, value)
+     end
+  end
+*/
+
+LUALIB_API int
+luaopen_posix_sys_eventfd(lua_State *L)
+{
+	luaL_newlib(L, posix_sys_eventfd_fns);
+	lua_pushstring(L, LPOSIX_VERSION_STRING("sys.eventfd"));
+	lua_setfield(L, -2, "version");
+
+#if HAVE_SYS_EVENTFD_H && HAVE_EVENTFD
+	LPOSIX_CONST( EFD_CLOEXEC	);
+	LPOSIX_CONST( EFD_NONBLOCK	);
+	LPOSIX_CONST( EFD_SEMAPHORE	);
+#endif
+
+	return 1;
+}
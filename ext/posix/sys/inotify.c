@@ -0,0 +1,337 @@
+/*
+ * POSIX library for Lua 5.1, 5.2, 5.3 & 5.4.
+ * Copyright (C) 2013-2025 Gary V. Vaughan
+ * Copyright (C) 2010-2013 Reuben Thomas <rrt@sc3d.org>
+ * Copyright (C) 2008-2010 Natanael Copa <natanael.copa@gmail.com>
+ * Clean up and bug fixes by Leo Razoumov <slonik.az@gmail.com> 2006-10-11
+ * Luiz Henrique de Figueiredo <lhf@tecgraf.puc-rio.br> 07 Apr 2006 23:17:49
+ * Based on original by Claudio Terra for Lua 3.x.
+ * With contributions by Roberto Ierusalimschy.
+ * With documentation from Steve Donovan 2012
+ */
+/***
+ Filesystem Event Notification.
+
+ Where supported by the underlying system, functions to watch files
+ and directories for changes through a file descriptor, which can be
+ waited on with @{posix.poll.poll} alongside other descriptors rather
+ than by polling with @{posix.sys.stat.stat}.  If the module loads
+ successfully, but there is no system support, then
+ `posix.sys.inotify.version` will be set, but the unsupported APIs will
+ be `nil`.
+
+@module posix.sys.inotify
+*/
+
+#include "_helpers.c"
+
+#if HAVE_SYS_INOTIFY_H && HAVE_INOTIFY_INIT1
+#include <sys/inotify.h>
+
+
+/* Events are read into a buffer on the C stack, which is large enough
+   for several hundred events with short names, and must be at least
+   sizeof(struct inotify_event) + NAME_MAX + 1 to hold any single one. */
+#define INO_BUFSIZE	16384
+#define INO_MAXEVENTS	(INO_BUFSIZE / sizeof(struct inotify_event))
+#define INO_HASHSIZE	2048	/* power of 2, >= 2 * INO_MAXEVENTS */
+
+
+/***
+Create an inotify instance.
+@function inotify_init1
+@int[opt=0] flags bitwise OR of zero or more of `IN_CLOEXEC` and
+  `IN_NONBLOCK`
+@treturn[1] int new file descriptor, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see inotify_init1(2)
+@usage
+  local inotify = require "posix.sys.inotify"
+  local ifd = inotify.inotify_init1(inotify.IN_NONBLOCK)
+*/
+static int
+Pinotify_init1(lua_State *L)
+{
+	int flags = optint(L, 1, 0);
+	checknargs(L, 1);
+	return pushresult(L, inotify_init1(flags), "inotify_init1");
+}
+
+
+/***
+Start watching a file or directory, or change an existing watch.
+@function inotify_add_watch
+@int fd file descriptor returned by @{inotify_init1}
+@string path file or directory to watch
+@int mask bitwise OR of the `IN_*` events to report, and zero or more of
+  `IN_DONT_FOLLOW`, `IN_EXCL_UNLINK`, `IN_MASK_ADD`, `IN_MASK_CREATE`,
+  `IN_ONESHOT` and `IN_ONLYDIR`
+@treturn[1] int watch descriptor, unique for *path* on *fd*, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see inotify_add_watch(2)
+@usage
+  local wd = inotify.inotify_add_watch(ifd, "/etc/myapp",
+    bor(inotify.IN_CLOSE_WRITE, inotify.IN_MOVED_TO, inotify.IN_DELETE))
+*/
+static int
+Pinotify_add_watch(lua_State *L)
+{
+	int fd = checkint(L, 1);
+	const char *path = luaL_checkstring(L, 2);
+	uint32_t mask = (uint32_t)checkinteger(L, 3);
+	checknargs(L, 3);
+	return pushresult(L, inotify_add_watch(fd, path, mask), path);
+}
+
+
+/***
+Stop watching a file or directory.
+An `IN_IGNORED` event is reported for *wd* once it has been removed.
+@function inotify_rm_watch
+@int fd file descriptor returned by @{inotify_init1}
+@int wd watch descriptor returned by @{inotify_add_watch}
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see inotify_rm_watch(2)
+*/
+static int
+Pinotify_rm_watch(lua_State *L)
+{
+	int fd = checkint(L, 1);
+	int wd = checkint(L, 2);
+	checknargs(L, 2);
+	return pushresult(L, inotify_rm_watch(fd, wd), "inotify_rm_watch");
+}
+
+
+static unsigned
+ino_hash(const struct inotify_event *ev)
+{
+	unsigned h = (unsigned)ev->wd * 2654435761u;
+	const char *p;
+	if (ev->len)
+		for (p = ev->name; *p; p++)
+			h = (h ^ (unsigned char)*p) * 16777619u;
+	return h;
+}
+
+
+static int
+ino_same(const struct inotify_event *a, const struct inotify_event *b)
+{
+	return a->wd == b->wd && STREQ(a->len ? a->name : "", b->len ? b->name : "");
+}
+
+
+/***
+Read pending events.
+Decodes every event available in a single read into one flat list, with
+four consecutive entries per event, to avoid creating a table for each:
+the watch descriptor, the event mask, the cookie that pairs
+`IN_MOVED_FROM` with `IN_MOVED_TO`, and the name of the file within a
+watched directory (or `""` for events on the watched path itself).
+
+With *coalesce*, all events for the same name on the same watch are
+merged into the first of them, with their masks ORed together, so that a
+file written many times since the last read is reported just once.
+Events with a non-zero cookie are never merged, so that renames can
+still be paired.
+
+Blocks until at least one event is available, unless *fd* was created
+with `IN_NONBLOCK`, in which case it fails with `EAGAIN` instead.
+@function inotify_read
+@int fd file descriptor returned by @{inotify_init1}
+@bool[opt=false] coalesce merge events for the same name on the same watch
+@treturn[1] table flat list of *wd*, *mask*, *cookie*, *name* for each event
+@treturn[1] int number of events in the list
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see inotify(7)
+@usage
+  local events, n = inotify.inotify_read(ifd, true)
+  for i = 1, n * 4, 4 do
+    local wd, mask, name = events[i], events[i + 1], events[i + 3]
+    if band(mask, inotify.IN_Q_OVERFLOW) ~= 0 then
+      rescan_everything()
+    else
+      reload(dirs[wd], name)
+    end
+  end
+*/
+static int
+Pinotify_read(lua_State *L)
+{
+	/* Align the buffer for struct inotify_event. */
+	union { struct inotify_event ev; char buf[INO_BUFSIZE]; } u;
+	const struct inotify_event *events[INO_MAXEVENTS];
+	uint32_t masks[INO_MAXEVENTS];
+	unsigned short slots[INO_HASHSIZE];
+	int fd = checkint(L, 1);
+	int coalesce = optboolean(L, 2, 0);
+	ssize_t r;
+	size_t off;
+	int i, n = 0;
+	checknargs(L, 2);
+
+	do
+		r = read(fd, u.buf, sizeof u.buf);
+	while (r == -1 && errno == EINTR);
+	if (r == -1)
+		return pusherror(L, "inotify_read");
+
+	if (coalesce)
+		memset(slots, 0, sizeof slots);
+	for (off = 0; off < (size_t)r; )
+	{
+		const struct inotify_event *ev = (const struct inotify_event *)(u.buf + off);
+		off += sizeof *ev + ev->len;
+		if (coalesce && ev->cookie == 0)
+		{
+			/* slots[] holds event index + 1, or 0 for an empty slot. */
+			unsigned h = ino_hash(ev) & (INO_HASHSIZE - 1);
+			for (; slots[h]; h = (h + 1) & (INO_HASHSIZE - 1))
+				if (ino_same(events[slots[h] - 1], ev))
+					break;
+			if (slots[h])
+			{
+				masks[slots[h] - 1] |= ev->mask;
+				continue;
+			}
+			slots[h] = (unsigned short)(n + 1);
+		}
+		events[n] = ev;
+		masks[n++] = ev->mask;
+	}
+
+	lua_createtable(L, n * 4, 0);
+	for (i = 0; i < n; i++)
+	{
+		lua_pushinteger(L, events[i]->wd);
+		lua_rawseti(L, -2, i * 4 + 1);
+		lua_pushinteger(L, masks[i]);
+		lua_rawseti(L, -2, i * 4 + 2);
+		lua_pushinteger(L, events[i]->cookie);
+		lua_rawseti(L, -2, i * 4 + 3);
+		lua_pushstring(L, events[i]->len ? events[i]->name : "");
+		lua_rawseti(L, -2, i * 4 + 4);
+	}
+	lua_pushinteger(L, n);
+	return 2;
+}
+#endif
+
+
+static const luaL_Reg posix_sys_inotify_fns[] =
+{
+#if HAVE_SYS_INOTIFY_H && HAVE_INOTIFY_INIT1
+	LPOSIX_FUNC( Pinotify_add_watch	),
+	LPOSIX_FUNC( Pinotify_init1	),
+	LPOSIX_FUNC( Pinotify_read	),
+	LPOSIX_FUNC( Pinotify_rm_watch	),
+#endif
+	{NULL, NULL}
+};
+
+
+/***
+Constants.
+@section constants
+*/
+
+/***
+Inotify constants.
+Any constants not available in the underlying system will be `nil` valued.
+@table posix.sys.inotify
+@int IN_ACCESS file was read
+@int IN_ALL_EVENTS all of the events below that can be watched for
+@int IN_ATTRIB metadata changed
+@int IN_CLOEXEC close the new file descriptor on exec
+@int IN_CLOSE `IN_CLOSE_WRITE` or `IN_CLOSE_NOWRITE`
+@int IN_CLOSE_NOWRITE file not opened for writing was closed
+@int IN_CLOSE_WRITE file opened for writing was closed
+@int IN_CREATE file or directory created in watched directory
+@int IN_DELETE file or directory deleted from watched directory
+@int IN_DELETE_SELF watched file or directory was deleted
+@int IN_DONT_FOLLOW do not follow a symbolic link *path*
+@int IN_EXCL_UNLINK ignore events for children after they are unlinked
+@int IN_IGNORED watch was removed
+@int IN_ISDIR event subject is a directory
+@int IN_MASK_ADD add to the mask of an existing watch, instead of replacing
+@int IN_MASK_CREATE fail with `EEXIST` if *path* is already watched
+@int IN_MODIFY file was modified
+@int IN_MOVE `IN_MOVED_FROM` or `IN_MOVED_TO`
+@int IN_MOVE_SELF watched file or directory was moved
+@int IN_MOVED_FROM file moved out of watched directory
+@int IN_MOVED_TO file moved into watched directory
+@int IN_NONBLOCK reads fail with `EAGAIN` instead of blocking
+@int IN_ONESHOT remove the watch after one event
+@int IN_ONLYDIR fail unless *path* is a directory
+@int IN_OPEN file was opened
+@int IN_Q_OVERFLOW event queue overflowed, so events were lost
+@int IN_UNMOUNT filesystem containing watched object was unmounted
+@usage
+  -- Print inotify constants supported on this host.
+  for name, value in pairs (require "posix.sys.inotify") do
+    if type (value) == "number" then
+      print (name, value)
+     end
+  end
+*/
+
+LUALIB_API int
+luaopen_posix_sys_inotify(lua_State *L)
+{
+	luaL_newlib(L, posix_sys_inotify_fns);
+	lua_pushstring(L, LPOSIX_VERSION_STRING("sys.inotify"));
+	lua_setfield(L, -2, "version");
+
+#if HAVE_SYS_INOTIFY_H && HAVE_INOTIFY_INIT1
+	/* events */
+	LPOSIX_CONST( IN_ACCESS		);
+	LPOSIX_CONST( IN_ALL_EVENTS	);
+	LPOSIX_CONST( IN_ATTRIB		);
+	LPOSIX_CONST( IN_CLOSE		);
+	LPOSIX_CONST( IN_CLOSE_NOWRITE	);
+	LPOSIX_CONST( IN_CLOSE_WRITE	);
+	LPOSIX_CONST( IN_CREATE		);
+	LPOSIX_CONST( IN_DELETE		);
+	LPOSIX_CONST( IN_DELETE_SELF	);
+	LPOSIX_CONST( IN_MODIFY		);
+	LPOSIX_CONST( IN_MOVE		);
+	LPOSIX_CONST( IN_MOVE_SELF	);
+	LPOSIX_CONST( IN_MOVED_FROM	);
+	LPOSIX_CONST( IN_MOVED_TO	);
+	LPOSIX_CONST( IN_OPEN		);
+
+	/* events reported without being watched for */
+	LPOSIX_CONST( IN_IGNORED	);
+	LPOSIX_CONST( IN_ISDIR		);
+	LPOSIX_CONST( IN_Q_OVERFLOW	);
+	LPOSIX_CONST( IN_UNMOUNT	);
+
+	/* watch flags */
+	LPOSIX_CONST( IN_DONT_FOLLOW	);
+#  ifdef IN_EXCL_UNLINK
+	LPOSIX_CONST( IN_EXCL_UNLINK	);
+#  endif
+	LPOSIX_CONST( IN_MASK_ADD	);
+#  ifdef IN_MASK_CREATE
+	LPOSIX_CONST( IN_MASK_CREATE	);
+#  endif
+	LPOSIX_CONST( IN_ONESHOT	);
+	LPOSIX_CONST( IN_ONLYDIR	);
+
+	/* inotify_init1 flags */
+	LPOSIX_CONST( IN_CLOEXEC	);
+	LPOSIX_CONST( IN_NONBLOCK	);
+#endif
+
+	return 1;
+}
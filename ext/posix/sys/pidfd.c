@@ -0,0 +1,185 @@
+/*
+ * POSIX library for Lua 5.1, 5.2, 5.3 & 5.4.
+ * Copyright (C) 2013-2025 Gary V. Vaughan
+ * Copyright (C) 2010-2013 Reuben Thomas <rrt@sc3d.org>
+ * Copyright (C) 2008-2010 Natanael Copa <natanael.copa@gmail.com>
+ * Clean up and bug fixes by Leo Razoumov <slonik.az@gmail.com> 2006-10-11
+ * Luiz Henrique de Figueiredo <lhf@tecgraf.puc-rio.br> 07 Apr 2006 23:17:49
+ * Based on original by Claudio Terra for Lua 3.x.
+ * With contributions by Roberto Ierusalimschy.
+ * With documentation from Steve Donovan 2012
+ */
+/***
+ Process File Descriptors.
+
+ Where supported by the underlying system, functions to refer to a
+ process through a file descriptor.  Unlike a process id, a pidfd
+ cannot be reused by another process after the one it refers to exits,
+ and it becomes readable when that process terminates, so children can
+ be supervised from a @{posix.poll.poll} loop, and reaped with
+ @{posix.sys.wait.waitid}(`P_PIDFD`, *pidfd*), without a `SIGCHLD`
+ handler.  If the module loads successfully, but there is no system
+ support, then `posix.sys.pidfd.version` will be set, but the
+ unsupported APIs will be `nil`.
+
+@module posix.sys.pidfd
+*/
+
+#include "_helpers.c"
+
+#if HAVE_SYS_PIDFD_H && HAVE_PIDFD_OPEN
+#include <signal.h>
+#include <sys/pidfd.h>
+#include <sys/wait.h>
+
+
+/***
+Obtain a file descriptor that refers to a process.
+The process id must not have been reaped already, so that it cannot have
+been reused; this is always the case for an unreaped child of the
+calling process.
+@function pidfd_open
+@int pid process id
+@int[opt=0] flags `0`, or `PIDFD_NONBLOCK` to make
+  @{posix.sys.wait.waitid} fail with `EAGAIN` rather than block
+@treturn[1] int new file descriptor, with `FD_CLOEXEC` set, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see pidfd_open(2)
+*/
+static int
+Ppidfd_open(lua_State *L)
+{
+	pid_t pid = (pid_t)checkinteger(L, 1);
+	unsigned flags = (unsigned)optinteger(L, 2, 0);
+	checknargs(L, 2);
+	return pushresult(L, pidfd_open(pid, flags), "pidfd_open");
+}
+
+
+/***
+Create a child process, and a file descriptor that refers to it.
+As @{posix.unistd.fork}, but also returns a pidfd for the child to the
+parent.  If no pidfd can be opened, the child is killed and reaped
+before returning the error, so that no unsupervised child is left
+behind.
+@function pidfd_fork
+@treturn[1] int `0` in the resulting child process
+@treturn[2] int process id of child, in the calling process
+@treturn[2] int pidfd referring to the child, in the calling process
+@return[3] nil
+@treturn[3] string error message
+@treturn[3] int errnum
+@see fork(2)
+@see pidfd_open(2)
+@usage
+  local pidfd = require "posix.sys.pidfd"
+  local pid, pfd = pidfd.pidfd_fork ()
+  if pid == 0 then
+    require "posix.unistd".execp ("worker", {})
+  end
+  -- pfd becomes readable when the worker exits
+  children[pfd] = pid
+*/
+static int
+Ppidfd_fork(lua_State *L)
+{
+	pid_t pid;
+	int pfd, err;
+	checknargs(L, 0);
+	pid = fork();
+	if (pid == -1)
+		return pusherror(L, "pidfd_fork");
+	if (pid == 0)
+		return pushintegerresult(0);
+
+	/* The child is not yet reaped, so its pid cannot have been reused. */
+	pfd = pidfd_open(pid, 0);
+	if (pfd == -1)
+	{
+		err = errno;
+		kill(pid, SIGKILL);
+		while (waitpid(pid, NULL, 0) == -1 && errno == EINTR)
+			;
+		errno = err;
+		return pusherror(L, "pidfd_fork");
+	}
+	lua_pushinteger(L, pid);
+	lua_pushinteger(L, pfd);
+	return 2;
+}
+
+
+/***
+Send a signal to a process through a pidfd.
+Unlike @{posix.signal.kill}, the signal can never be delivered to an
+unrelated process that has reused the process id.
+@function pidfd_send_signal
+@int pidfd file descriptor returned by @{pidfd_open} or @{pidfd_fork}
+@int sig signal to send, or `0` to check that the process still exists
+@int[opt=0] flags must be `0`
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see pidfd_send_signal(2)
+*/
+static int
+Ppidfd_send_signal(lua_State *L)
+{
+	int pfd = checkint(L, 1);
+	int sig = checkint(L, 2);
+	unsigned flags = (unsigned)optinteger(L, 3, 0);
+	checknargs(L, 3);
+	return pushresult(L, pidfd_send_signal(pfd, sig, NULL, flags), "pidfd_send_signal");
+}
+#endif
+
+
+static const luaL_Reg posix_sys_pidfd_fns[] =
+{
+#if HAVE_SYS_PIDFD_H && HAVE_PIDFD_OPEN
+	LPOSIX_FUNC( Ppidfd_fork	),
+	LPOSIX_FUNC( Ppidfd_open	),
+	LPOSIX_FUNC( Ppidfd_send_signal	),
+#endif
+	{NULL, NULL}
+};
+
+
+/***
+Constants.
+@section constants
+*/
+
+/***
+Pidfd constants.
+Any constants not available in the underlying system will be `nil` valued.
+@table posix.sys.pidfd
+@int PIDFD_NONBLOCK waiting on the pidfd fails with `EAGAIN` instead of
+  blocking
+@usage
+  -- Print pidfd constants supported on this host.
+  for name, value in pairs (require "posix.sys.pidfd") do
+    if type (value) == "number" then
+      print (name, value)
+     end
+  end
+*/
+
+LUALIB_API int
+luaopen_posix_sys_pidfd(lua_State *L)
+{
+	luaL_newlib(L, posix_sys_pidfd_fns);
+	lua_pushstring(L, LPOSIX_VERSION_STRING("sys.pidfd"));
+	lua_setfield(L, -2, "version");
+
+#if HAVE_SYS_PIDFD_H && HAVE_PIDFD_OPEN
+#  ifdef PIDFD_NONBLOCK
+	LPOSIX_CONST( PIDFD_NONBLOCK	);
+#  endif
+#endif
+
+	return 1;
+}
@@ -15,9 +15,11 @@
 @module posix.sys.resource
 */
 
+#include "_helpers.c"	/* for _GNU_SOURCE, needed by prlimit */
+
 #include <sys/resource.h>
 
-#include "_helpers.c"
+#include "_rusage.c"
 
 /* OpenBSD 5.6 recommends using RLIMIT_DATA in place of missing RLIMIT_AS */
 #ifndef RLIMIT_AS
@@ -25,6 +27,29 @@
 #endif
 
 
+/***
+Resource usage record.
+Fields not maintained by the underlying system are `0`.
+@table PosixRusage
+@tparam posix.sys.time.PosixTimeval ru_utime user CPU time used
+@tparam posix.sys.time.PosixTimeval ru_stime system CPU time used
+@int ru_maxrss maximum resident set size, in kilobytes on most systems
+@int ru_ixrss integral shared memory size
+@int ru_idrss integral unshared data size
+@int ru_isrss integral unshared stack size
+@int ru_minflt page faults serviced without I/O
+@int ru_majflt page faults requiring I/O
+@int ru_nswap swaps
+@int ru_inblock block input operations
+@int ru_oublock block output operations
+@int ru_msgsnd IPC messages sent
+@int ru_msgrcv IPC messages received
+@int ru_nsignals signals received
+@int ru_nvcsw voluntary context switches
+@int ru_nivcsw involuntary context switches
+*/
+
+
 /***
 Resource limit record.
 @table PosixRlimit
@@ -51,7 +76,8 @@ pushrlimit(lua_State *L, struct rlimit *lim)
 Get resource limits for this process.
 @function getrlimit
 @int resource one of `RLIMIT_CORE`, `RLIMIT_CPU`, `RLIMIT_DATA`, `RLIMIT_FSIZE`,
-  `RLIMIT_NOFILE`, `RLIMIT_STACK` or `RLIMIT_AS`
+  `RLIMIT_NOFILE`, `RLIMIT_STACK` or `RLIMIT_AS` (or one of the other
+  `RLIMIT_*` constants, where supported)
 @treturn[1] int softlimit
 @treturn[1] int hardlimit, if successful
 @return[2] nil
@@ -80,7 +106,8 @@ Pgetrlimit(lua_State *L)
 Set a resource limit for subsequent child processes.
 @function setrlimit
 @int resource one of `RLIMIT_CORE`, `RLIMIT_CPU`, `RLIMIT_DATA`, `RLIMIT_FSIZE`,
-  `RLIMIT_NOFILE`, `RLIMIT_STACK` or `RLIMIT_AS`
+  `RLIMIT_NOFILE`, `RLIMIT_STACK` or `RLIMIT_AS` (or one of the other
+  `RLIMIT_*` constants, where supported)
 @param[opt] softlimit process may receive a signal when reached
 @param[opt] hardlimit process may be terminated when reached
 @treturn[1] int `0`, if successful
@@ -99,6 +126,14 @@ Set a resource limit for subsequent child processes.
 
 static const char *Srlimit_fields[] = { "rlim_cur", "rlim_max" };
 
+static void
+torlimit(lua_State *L, int index, struct rlimit *lim)
+{
+	lim->rlim_cur = (rlim_t)checkintegerfield(L, index, "rlim_cur");
+	lim->rlim_max = (rlim_t)checkintegerfield(L, index, "rlim_max");
+	checkfieldnames(L, index, Srlimit_fields);
+}
+
 static int
 Psetrlimit(lua_State *L)
 {
@@ -108,17 +143,91 @@ Psetrlimit(lua_State *L)
 	luaL_checktype(L, 2, LUA_TTABLE);
 	checknargs(L, 2);
 
-	lim.rlim_cur = (rlim_t)checkintegerfield(L, 2, "rlim_cur");
-	lim.rlim_max = (rlim_t)checkintegerfield(L, 2, "rlim_max");
-	checkfieldnames(L, 2, Srlimit_fields);
+	torlimit(L, 2, &lim);
 
 	return pushresult(L, setrlimit(rid, &lim), "setrlimit");
 }
 
 
+#if HAVE_PRLIMIT
+/***
+Get and optionally set a resource limit for any process.
+Like @{getrlimit} and @{setrlimit}, but for the process *pid*, which
+requires the same privileges as sending it a signal, and atomically
+returns the previous limit when setting a new one.
+@function prlimit
+@int pid process to act on, or `0` for this process
+@int resource one of the `RLIMIT_*` constants
+@tparam[opt] PosixRlimit limit new soft and hard limits, if any
+@treturn[1] PosixRlimit limits in force before the call, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see prlimit(2)
+@usage
+  local sysres = require "posix.sys.resource"
+  -- raise our memlock soft limit to the hard limit before pinning buffers
+  local lim = sysres.prlimit(0, sysres.RLIMIT_MEMLOCK)
+  lim.rlim_cur = lim.rlim_max
+  sysres.prlimit(0, sysres.RLIMIT_MEMLOCK, lim)
+*/
+static int
+Pprlimit(lua_State *L)
+{
+	struct rlimit newlim, oldlim;
+	pid_t pid = (pid_t)checkinteger(L, 1);
+	int rid = checkint(L, 2);
+	int set = !lua_isnoneornil(L, 3);
+	checknargs(L, 3);
+
+	if (set)
+	{
+		luaL_checktype(L, 3, LUA_TTABLE);
+		torlimit(L, 3, &newlim);
+	}
+	if (prlimit(pid, rid, set ? &newlim : NULL, &oldlim) == -1)
+		return pusherror(L, "prlimit");
+	return pushrlimit(L, &oldlim);
+}
+#endif
+
+
+/***
+Get resource usage.
+@function getrusage
+@int[opt=RUSAGE_SELF] who one of `RUSAGE_SELF`, `RUSAGE_CHILDREN` or,
+  where supported, `RUSAGE_THREAD`
+@treturn[1] PosixRusage resources used, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see getrusage(2)
+@usage
+  local sysres = require "posix.sys.resource"
+  local before = sysres.getrusage()
+  handle_batch(requests)
+  local after = sysres.getrusage()
+  export("majflt", after.ru_majflt - before.ru_majflt)
+*/
+static int
+Pgetrusage(lua_State *L)
+{
+	struct rusage ru;
+	int who = optint(L, 1, RUSAGE_SELF);
+	checknargs(L, 1);
+	if (getrusage(who, &ru) == -1)
+		return pusherror(L, "getrusage");
+	return pushrusage(L, &ru);
+}
+
+
 static const luaL_Reg posix_sys_resource_fns[] =
 {
 	LPOSIX_FUNC( Pgetrlimit		),
+	LPOSIX_FUNC( Pgetrusage		),
+#if HAVE_PRLIMIT
+	LPOSIX_FUNC( Pprlimit		),
+#endif
 	LPOSIX_FUNC( Psetrlimit		),
 	{NULL, NULL}
 };
@@ -131,6 +240,7 @@ Constants.
 
 /***
 Rlimit constants.
+Any constants not available in the underlying system will be `nil` valued.
 @table posix.sys.resource
 @int RLIM_INFINITY unlimited resource usage
 @int RLIM_SAVED_CUR saved current resource soft limit
@@ -142,6 +252,19 @@ Rlimit constants.
 @int RLIMIT_NOFILE maximum number of open files per process
 @int RLIMIT_STACK maximum stack segment bytes per process
 @int RLIMIT_AS maximum bytes total address space per process
+@int RLIMIT_LOCKS maximum number of file locks per process
+@int RLIMIT_MEMLOCK maximum bytes of memory locked into RAM per process
+@int RLIMIT_MSGQUEUE maximum bytes in POSIX message queues per user
+@int RLIMIT_NICE ceiling for raising the nice value, as `20 - rlim_cur`
+@int RLIMIT_NPROC maximum number of processes per user
+@int RLIMIT_RSS maximum bytes of resident set size per process
+@int RLIMIT_RTPRIO ceiling for the real-time scheduling priority
+@int RLIMIT_RTTIME maximum microseconds of real-time CPU time without
+  blocking
+@int RLIMIT_SIGPENDING maximum number of signals queued per user
+@int RUSAGE_CHILDREN resources used by reaped descendants, for @{getrusage}
+@int RUSAGE_SELF resources used by this process, for @{getrusage}
+@int RUSAGE_THREAD resources used by the calling thread, for @{getrusage}
 @usage
   -- Print resource constants supported on this host.
   for name, value in pairs (require "posix.sys.resource") do
@@ -172,6 +295,40 @@ luaopen_posix_sys_resource(lua_State *L)
 	LPOSIX_CONST( RLIMIT_NOFILE	);
 	LPOSIX_CONST( RLIMIT_STACK	);
 	LPOSIX_CONST( RLIMIT_AS		);
+#ifdef RLIMIT_LOCKS
+	LPOSIX_CONST( RLIMIT_LOCKS	);
+#endif
+#ifdef RLIMIT_MEMLOCK
+	LPOSIX_CONST( RLIMIT_MEMLOCK	);
+#endif
+#ifdef RLIMIT_MSGQUEUE
+	LPOSIX_CONST( RLIMIT_MSGQUEUE	);
+#endif
+#ifdef RLIMIT_NICE
+	LPOSIX_CONST( RLIMIT_NICE	);
+#endif
+#ifdef RLIMIT_NPROC
+	LPOSIX_CONST( RLIMIT_NPROC	);
+#endif
+#ifdef RLIMIT_RSS
+	LPOSIX_CONST( RLIMIT_RSS	);
+#endif
+#ifdef RLIMIT_RTPRIO
+	LPOSIX_CONST( RLIMIT_RTPRIO	);
+#endif
+#ifdef RLIMIT_RTTIME
+	LPOSIX_CONST( RLIMIT_RTTIME	);
+#endif
+#ifdef RLIMIT_SIGPENDING
+	LPOSIX_CONST( RLIMIT_SIGPENDING	);
+#endif
+
+	/* getrusage arguments */
+	LPOSIX_CONST( RUSAGE_CHILDREN	);
+	LPOSIX_CONST( RUSAGE_SELF	);
+#ifdef RUSAGE_THREAD
+	LPOSIX_CONST( RUSAGE_THREAD	);
+#endif
 
 	return 1;
 }
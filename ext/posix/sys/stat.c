@@ -15,9 +15,14 @@
 @module posix.sys.stat
 */
 
+/* _helpers.c defines _GNU_SOURCE, which must precede <sys/stat.h> for
+   statx to be declared. */
+#include "_helpers.c"
+
+#include <fcntl.h>
 #include <sys/stat.h>
 
-#include "_helpers.c"
+#include "_stat.c"
 
 
 /***
@@ -36,35 +41,14 @@ File state record.
 @int st_ctime time of last state change
 @int st_blksize preferred block size
 @int st_blocks number of blocks allocated
+@usage
+  -- Passing true as the last argument to stat, lstat or fstat returns
+  -- a userdata holding the raw struct stat instead, which converts each
+  -- field only when it is read, and has S_ISDIR style methods and a
+  -- totable method that returns the equivalent table.
+  local st = sys_stat.stat(path, true)
+  if st:S_ISREG() ~= 0 then print(st.st_size) end
 */
-static int
-pushstat(lua_State *L, struct stat *st)
-{
-	if (!st)
-		return lua_pushnil(L), 1;
-
-	lua_createtable(L, 0, 13);
-
-	setintegerfield(st, st_dev);
-	setintegerfield(st, st_ino);
-	setintegerfield(st, st_mode);
-	setintegerfield(st, st_nlink);
-	setintegerfield(st, st_uid);
-	setintegerfield(st, st_gid);
-	setintegerfield(st, st_rdev);
-	setintegerfield(st, st_size);
-	setintegerfield(st, st_blksize);
-	setintegerfield(st, st_blocks);
-
-	/* st_[amc]time is a macro on at least Mac OS, so we have to
-	   assign field name strings manually. */
-        pushintegerfield("st_atime", st->st_atime);
-        pushintegerfield("st_mtime", st->st_mtime);
-        pushintegerfield("st_ctime", st->st_ctime);
-
-	settypemetatable("PosixStat");
-	return 1;
-}
 
 
 /***
@@ -165,6 +149,23 @@ PS_ISSOCK(lua_State *L)
 }
 
 
+#define STAT_HANDLE	PACKAGE " stat handle"
+
+/* Push *st* as a PosixStat table or, if *lazy*, as a userdata copy of
+   the struct whose fields are only converted when read. */
+static int
+pushstatmaybelazy(lua_State *L, struct stat *st, int lazy)
+{
+	if (!lazy)
+		return pushstat(L, st);
+
+	memcpy(lua_newuserdata(L, sizeof *st), st, sizeof *st);
+	luaL_getmetatable(L, STAT_HANDLE);
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
+
 /***
 Change the mode of the path.
 @function chmod
@@ -188,11 +189,37 @@ Pchmod(lua_State *L)
 }
 
 
+/***
+Change the mode of a path relative to a directory file descriptor.
+@function fchmodat
+@int dirfd directory file descriptor, or `posix.fcntl.AT_FDCWD`
+@string path file to act on, relative to *dirfd* unless absolute
+@int mode access modes to set for *path*
+@int[opt=0] flags `0` or `posix.fcntl.AT_SYMLINK_NOFOLLOW`
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see fchmodat(2)
+*/
+static int
+Pfchmodat(lua_State *L)
+{
+	int dirfd = checkint(L, 1);
+	const char *path = luaL_checkstring(L, 2);
+	mode_t mode = (mode_t)checkinteger(L, 3);
+	int flags = optint(L, 4, 0);
+	checknargs(L, 4);
+	return pushresult(L, fchmodat(dirfd, path, mode, flags), path);
+}
+
+
 /***
 Information about an existing file path.
 If file is a symbolic link, return information about the link itself.
 @function lstat
 @string path file to act on
+@bool[opt=false] lazy return a lazy @{PosixStat} userdata instead of a table
 @treturn[1] PosixStat information about *path*, if successful
 @return[2] nil
 @treturn[2] string error message
@@ -208,10 +235,11 @@ Plstat(lua_State *L)
 {
 	struct stat s;
 	const char *path = luaL_checkstring(L, 1);
-	checknargs(L, 1);
+	int lazy = optboolean(L, 2, 0);
+	checknargs(L, 2);
 	if (lstat(path, &s) == -1)
 		return pusherror(L, path);
-	return pushstat(L, &s);
+	return pushstatmaybelazy(L, &s, lazy);
 }
 
 
@@ -219,6 +247,7 @@ Plstat(lua_State *L)
 Information about a file descriptor.
 @function fstat
 @int fd file descriptor to act on
+@bool[opt=false] lazy return a lazy @{PosixStat} userdata instead of a table
 @treturn[1] PosixStat information about *fd*, if successful
 @return[2] nil
 @treturn[2] string error message
@@ -236,10 +265,46 @@ Pfstat(lua_State *L)
 {
 	struct stat s;
 	int fd = checkint(L, 1);
-	checknargs(L, 1);
+	int lazy = optboolean(L, 2, 0);
+	checknargs(L, 2);
 	if (fstat(fd, &s) == -1)
 		return pusherror(L, "fstat");
-	return pushstat(L, &s);
+	return pushstatmaybelazy(L, &s, lazy);
+}
+
+
+/***
+Information about a path relative to a directory file descriptor.
+@function fstatat
+@int dirfd directory file descriptor, or `posix.fcntl.AT_FDCWD`
+@string path file to act on, relative to *dirfd* unless absolute
+@int[opt=0] flags bitwise OR of zero or more of
+  `posix.fcntl.AT_SYMLINK_NOFOLLOW` and `posix.fcntl.AT_EMPTY_PATH`
+@bool[opt=false] lazy return a lazy @{PosixStat} userdata instead of a table
+@treturn[1] PosixStat information about *path*, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see fstatat(2)
+@see stat
+@usage
+  local fcntl = require "posix.fcntl"
+  local sys_stat = require "posix.sys.stat"
+  local dirfd = assert(fcntl.open("/etc", fcntl.O_RDONLY))
+  print(sys_stat.fstatat(dirfd, "passwd").st_size)
+*/
+static int
+Pfstatat(lua_State *L)
+{
+	struct stat s;
+	int dirfd = checkint(L, 1);
+	const char *path = luaL_checkstring(L, 2);
+	int flags = optint(L, 3, 0);
+	int lazy = optboolean(L, 4, 0);
+	checknargs(L, 4);
+	if (fstatat(dirfd, path, &s, flags) == -1)
+		return pusherror(L, path);
+	return pushstatmaybelazy(L, &s, lazy);
 }
 
 
@@ -263,6 +328,29 @@ Pmkdir(lua_State *L)
 }
 
 
+/***
+Make a directory relative to a directory file descriptor.
+@function mkdirat
+@int dirfd directory file descriptor, or `posix.fcntl.AT_FDCWD`
+@string path location to create directory, relative to *dirfd* unless
+  absolute
+@int[opt=511] mode access modes to set for *path*
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see mkdirat(2)
+*/
+static int
+Pmkdirat(lua_State *L)
+{
+	int dirfd = checkint(L, 1);
+	const char *path = luaL_checkstring(L, 2);
+	checknargs(L, 3);
+	return pushresult(L, mkdirat(dirfd, path, (mode_t)optinteger(L, 3, 0777)), path);
+}
+
+
 /***
 Make a FIFO pipe.
 @function mkfifo
@@ -288,6 +376,7 @@ Information about an existing file path.
 If file is a symbolic link, return information about the file the link points to.
 @function stat
 @string path file to act on
+@bool[opt=false] lazy return a lazy @{PosixStat} userdata instead of a table
 @treturn[1] PosixStat information about *path*, if successful
 @return[2] nil
 @treturn[2] string error message
@@ -303,13 +392,351 @@ Pstat(lua_State *L)
 {
 	struct stat s;
 	const char *path = luaL_checkstring(L, 1);
-	checknargs(L, 1);
+	int lazy = optboolean(L, 2, 0);
+	checknargs(L, 2);
 	if (stat(path, &s) == -1)
 		return pusherror(L, path);
-	return pushstat(L, &s);
+	return pushstatmaybelazy(L, &s, lazy);
+}
+
+
+static const char *const Sstat_fields[] = {
+	"st_dev", "st_ino", "st_mode", "st_nlink", "st_uid", "st_gid", "st_rdev",
+	"st_size", "st_atime", "st_mtime", "st_ctime", "st_blksize", "st_blocks",
+	NULL
+};
+#define NSTAT_FIELDS	(sizeof Sstat_fields / sizeof *Sstat_fields - 1)
+
+/* Value of the PosixStat field at Sstat_fields[i]. */
+static lua_Integer
+statfield(const struct stat *st, int i)
+{
+	switch (i)
+	{
+		case 0:  return st->st_dev;
+		case 1:  return st->st_ino;
+		case 2:  return st->st_mode;
+		case 3:  return st->st_nlink;
+		case 4:  return st->st_uid;
+		case 5:  return st->st_gid;
+		case 6:  return st->st_rdev;
+		case 7:  return st->st_size;
+		case 8:  return st->st_atime;
+		case 9:  return st->st_mtime;
+		case 10: return st->st_ctime;
+		case 11: return st->st_blksize;
+		default: return st->st_blocks;
+	}
 }
 
 
+/* Index of PosixStat field *k* in Sstat_fields, decided on the first
+   distinguishing character and confirmed with a single comparison, or
+   -1 if *k* is not a field name. */
+static int
+statfieldindex(const char *k, size_t len)
+{
+	int i = -1;
+	if (len < 6 || k[0] != 's' || k[1] != 't' || k[2] != '_')
+		return -1;
+	switch (k[3])
+	{
+		case 'a': i = 8;				break;
+		case 'b': i = k[5] == 'k' ? 11 : 12;		break;
+		case 'c': i = 10;				break;
+		case 'd': i = 0;				break;
+		case 'g': i = 5;				break;
+		case 'i': i = 1;				break;
+		case 'm': i = k[4] == 'o' ? 2 : 9;		break;
+		case 'n': i = 3;				break;
+		case 'r': i = 6;				break;
+		case 's': i = 7;				break;
+		case 'u': i = 4;				break;
+	}
+	return i >= 0 && STREQ(k, Sstat_fields[i]) ? i : -1;
+}
+
+
+static int
+statud_index(lua_State *L)
+{
+	struct stat *st = (struct stat *)luaL_checkudata(L, 1, STAT_HANDLE);
+	size_t len;
+	const char *k = lua_tolstring(L, 2, &len);
+	int i = k ? statfieldindex(k, len) : -1;
+	if (i >= 0)
+		return pushintegerresult(statfield(st, i));
+	/* Otherwise, look up a method in the first upvalue. */
+	lua_pushvalue(L, 2);
+	lua_rawget(L, lua_upvalueindex(1));
+	return 1;
+}
+
+
+#define STATUD_TEST(_n, _test)						\
+static int								\
+_n(lua_State *L)							\
+{									\
+	struct stat *st = (struct stat *)luaL_checkudata(L, 1, STAT_HANDLE); \
+	return pushintegerresult(_test(st->st_mode));			\
+}
+STATUD_TEST(statud_ISBLK,	S_ISBLK)
+STATUD_TEST(statud_ISCHR,	S_ISCHR)
+STATUD_TEST(statud_ISDIR,	S_ISDIR)
+STATUD_TEST(statud_ISFIFO,	S_ISFIFO)
+STATUD_TEST(statud_ISLNK,	S_ISLNK)
+STATUD_TEST(statud_ISREG,	S_ISREG)
+STATUD_TEST(statud_ISSOCK,	S_ISSOCK)
+
+
+static int
+statud_totable(lua_State *L)
+{
+	return pushstat(L, (struct stat *)luaL_checkudata(L, 1, STAT_HANDLE));
+}
+
+
+static const luaL_Reg statud_methods[] =
+{
+	{"S_ISBLK",	statud_ISBLK},
+	{"S_ISCHR",	statud_ISCHR},
+	{"S_ISDIR",	statud_ISDIR},
+	{"S_ISFIFO",	statud_ISFIFO},
+	{"S_ISLNK",	statud_ISLNK},
+	{"S_ISREG",	statud_ISREG},
+	{"S_ISSOCK",	statud_ISSOCK},
+	{"totable",	statud_totable},
+	{NULL, NULL}
+};
+
+
+/***
+Information about many paths at once.
+Calls `fstatat` for every path in a single C loop, and returns the
+results in columns, one list per requested @{PosixStat} field, rather
+than one table per path.  Entries for paths that could not be examined
+are `false` in every column, with the reason in the `errno` column,
+which is `0` for paths that succeeded.
+@function statmany
+@int[opt=AT_FDCWD] dirfd directory that relative *paths* are resolved
+  against, or `nil` for the current directory
+@tparam table paths list of path strings
+@tparam[opt] table fields list of @{PosixStat} field names to return,
+  or `nil` for all of them
+@int[opt=0] flags `0`, or `posix.fcntl.AT_SYMLINK_NOFOLLOW` to examine
+  symbolic links themselves
+@treturn table columns keyed by field name, each a list in the same
+  order as *paths*, plus an `errno` column
+@treturn int number of paths that could not be examined
+@see fstatat(2)
+@usage
+  local cols, nerr = sys_stat.statmany(nil, paths, {"st_size", "st_mtime"})
+  for i, path in ipairs(paths) do
+    if cols.errno[i] == 0 then print(path, cols.st_size[i]) end
+  end
+*/
+static int
+Pstatmany(lua_State *L)
+{
+	int dirfd = lua_isnoneornil(L, 1) ? AT_FDCWD : checkint(L, 1);
+	int flags = optint(L, 4, 0);
+	int which[NSTAT_FIELDS];
+	int nfields = 0, nerr = 0, i, j, n, result, errcol;
+
+	luaL_checktype(L, 2, LUA_TTABLE);
+	if (!lua_isnoneornil(L, 3))
+		luaL_checktype(L, 3, LUA_TTABLE);
+	checknargs(L, 4);
+	n = (int)lua_objlen(L, 2);
+
+	if (lua_isnoneornil(L, 3))
+		for (nfields = 0; nfields < (int)NSTAT_FIELDS; nfields++)
+			which[nfields] = nfields;
+	else
+	{
+		int nnames = (int)lua_objlen(L, 3);
+		luaL_argcheck(L, nnames <= (int)NSTAT_FIELDS, 3, "too many fields");
+		for (i = 1; i <= nnames; i++)
+		{
+			const char *name;
+			lua_rawgeti(L, 3, i);
+			name = lua_tostring(L, -1);
+			for (j = 0; name && Sstat_fields[j]; j++)
+				if (STREQ(name, Sstat_fields[j]))
+					break;
+			if (name == NULL || Sstat_fields[j] == NULL)
+				luaL_argerror(L, 3, lua_pushfstring(L,
+					"invalid field name '%s'", name ? name : "?"));
+			which[nfields++] = j;
+			lua_pop(L, 1);
+		}
+	}
+
+	/* One result table, followed on the stack by each column. */
+	lua_settop(L, 4);
+	lua_createtable(L, 0, nfields + 1);
+	result = lua_gettop(L);
+	for (j = 0; j < nfields; j++)
+	{
+		lua_createtable(L, n, 0);
+		lua_pushvalue(L, -1);
+		lua_setfield(L, result, Sstat_fields[which[j]]);
+	}
+	lua_createtable(L, n, 0);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, result, "errno");
+	errcol = lua_gettop(L);
+
+	for (i = 1; i <= n; i++)
+	{
+		struct stat st;
+		int r;
+		lua_rawgeti(L, 2, i);
+		luaL_argcheck(L, lua_type(L, -1) == LUA_TSTRING, 2,
+			lua_pushfstring(L, "string expected at index %d", i));
+		r = fstatat(dirfd, lua_tostring(L, -1), &st, flags);
+		lua_pop(L, 1);
+
+		for (j = 0; j < nfields; j++)
+		{
+			if (r == 0)
+				lua_pushinteger(L, statfield(&st, which[j]));
+			else
+				lua_pushboolean(L, 0);
+			lua_rawseti(L, result + 1 + j, i);
+		}
+		if (r != 0)
+			nerr++;
+		lua_pushinteger(L, r == 0 ? 0 : errno);
+		lua_rawseti(L, errcol, i);
+	}
+
+	lua_settop(L, result);
+	lua_pushinteger(L, nerr);
+	return 2;
+}
+
+
+#if HAVE_STATX
+static void
+pushstatxtimestamp(lua_State *L, const char *k, struct statx_timestamp *ts)
+{
+	lua_createtable(L, 0, 2);
+	setintegerfield(ts, tv_sec);
+	setintegerfield(ts, tv_nsec);
+	settypemetatable("PosixTimespec");
+	lua_setfield(L, -2, k);
+}
+
+
+/***
+Extended file state record.
+Only the fields selected by both the requested mask and the returned
+*stx_mask* are present.
+@table PosixStatx
+@int stx_mask bitwise OR of `STATX_*` flags for the fields filled in
+@int stx_blksize preferred block size
+@int stx_attributes bitwise OR of `STATX_ATTR_*` file attributes
+@int stx_attributes_mask attributes supported by the file system
+@int stx_dev_major major device id of the containing file system
+@int stx_dev_minor minor device id of the containing file system
+@int stx_rdev_major major device id, for special files
+@int stx_rdev_minor minor device id, for special files
+@int stx_nlink number of hardlinks, with `STATX_NLINK`
+@int stx_uid user id of file owner, with `STATX_UID`
+@int stx_gid group id of file owner, with `STATX_GID`
+@int stx_mode type and mode of file, with `STATX_TYPE` or `STATX_MODE`
+@int stx_ino inode number, with `STATX_INO`
+@int stx_size file size in bytes, with `STATX_SIZE`
+@int stx_blocks number of 512-byte blocks allocated, with `STATX_BLOCKS`
+@tparam posix.time.PosixTimespec stx_atime last access, with `STATX_ATIME`
+@tparam posix.time.PosixTimespec stx_btime creation, with `STATX_BTIME`
+@tparam posix.time.PosixTimespec stx_ctime last state change, with
+  `STATX_CTIME`
+@tparam posix.time.PosixTimespec stx_mtime last data modification, with
+  `STATX_MTIME`
+*/
+static int
+pushstatx(lua_State *L, struct statx *stx, unsigned int mask)
+{
+	mask &= stx->stx_mask;
+	lua_createtable(L, 0, 20);
+
+	setintegerfield(stx, stx_mask);
+	setintegerfield(stx, stx_blksize);
+	setintegerfield(stx, stx_attributes);
+	setintegerfield(stx, stx_attributes_mask);
+	setintegerfield(stx, stx_dev_major);
+	setintegerfield(stx, stx_dev_minor);
+	setintegerfield(stx, stx_rdev_major);
+	setintegerfield(stx, stx_rdev_minor);
+	if (mask & STATX_NLINK)
+		setintegerfield(stx, stx_nlink);
+	if (mask & STATX_UID)
+		setintegerfield(stx, stx_uid);
+	if (mask & STATX_GID)
+		setintegerfield(stx, stx_gid);
+	if (mask & (STATX_TYPE | STATX_MODE))
+		setintegerfield(stx, stx_mode);
+	if (mask & STATX_INO)
+		setintegerfield(stx, stx_ino);
+	if (mask & STATX_SIZE)
+		setintegerfield(stx, stx_size);
+	if (mask & STATX_BLOCKS)
+		setintegerfield(stx, stx_blocks);
+	if (mask & STATX_ATIME)
+		pushstatxtimestamp(L, "stx_atime", &stx->stx_atime);
+	if (mask & STATX_BTIME)
+		pushstatxtimestamp(L, "stx_btime", &stx->stx_btime);
+	if (mask & STATX_CTIME)
+		pushstatxtimestamp(L, "stx_ctime", &stx->stx_ctime);
+	if (mask & STATX_MTIME)
+		pushstatxtimestamp(L, "stx_mtime", &stx->stx_mtime);
+
+	settypemetatable("PosixStatx");
+	return 1;
+}
+
+
+/***
+Extended information about a file, with nanosecond timestamps.
+Only the fields in *mask* are fetched and returned, so asking for less
+can be cheaper, particularly on network file systems.
+@function statx
+@int[opt=AT_FDCWD] dirfd directory that a relative *path* is resolved
+  against, or `nil` for the current directory
+@string path file to act on
+@int[opt=0] flags bitwise OR of zero or more of
+  `posix.fcntl.AT_SYMLINK_NOFOLLOW`, `posix.fcntl.AT_EMPTY_PATH`,
+  `posix.fcntl.AT_NO_AUTOMOUNT` and one of `AT_STATX_SYNC_AS_STAT`,
+  `AT_STATX_FORCE_SYNC` or `AT_STATX_DONT_SYNC`
+@int[opt=STATX_BASIC_STATS] mask bitwise OR of `STATX_*` fields wanted
+@treturn[1] PosixStatx information about *path*, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see statx(2)
+@usage
+  local st = sys_stat.statx(nil, "Makefile", sys_stat.AT_STATX_DONT_SYNC,
+    bor(sys_stat.STATX_SIZE, sys_stat.STATX_MTIME))
+  print(st.stx_size, st.stx_mtime.tv_sec, st.stx_mtime.tv_nsec)
+*/
+static int
+Pstatx(lua_State *L)
+{
+	struct statx stx;
+	int dirfd = lua_isnoneornil(L, 1) ? AT_FDCWD : checkint(L, 1);
+	const char *path = luaL_checkstring(L, 2);
+	int flags = optint(L, 3, 0);
+	unsigned int mask = (unsigned int)optinteger(L, 4, STATX_BASIC_STATS);
+	checknargs(L, 4);
+	if (statx(dirfd, path, flags, mask, &stx) == -1)
+		return pusherror(L, path);
+	return pushstatx(L, &stx, mask);
+}
+#endif
+
+
 /***
 Set file mode creation mask.
 @function umask
@@ -326,6 +753,76 @@ Pumask(lua_State *L)
 }
 
 
+static const char *Sutimens_fields[] = { "atime", "mtime" };
+static const char *Sutimens_timespec_fields[] = { "tv_sec", "tv_nsec" };
+
+/* A missing or nil member of the times table means the current time. */
+static void
+toutimensmember(lua_State *L, int index, const char *k, struct timespec *ts)
+{
+	int got_type, subindex;
+	lua_getfield(L, index, k);
+	got_type = lua_type(L, -1);
+	lua_pop(L, 1);
+	if (got_type == LUA_TNONE || got_type == LUA_TNIL)
+	{
+		ts->tv_sec = 0;
+		ts->tv_nsec = UTIME_NOW;
+		return;
+	}
+
+	/* Leaves the member table on the top of the stack. */
+	checkfieldtype(L, index, k, LUA_TTABLE, "table");
+	subindex = lua_gettop(L);
+	ts->tv_sec  = (time_t)optintegerfield(L, subindex, "tv_sec", 0);
+	ts->tv_nsec = optlongfield(L, subindex, "tv_nsec", 0);
+	checkfieldnames(L, subindex, Sutimens_timespec_fields);
+	lua_pop(L, 1);
+}
+
+
+/***
+Change file access and modification times, with nanosecond precision.
+@function utimensat
+@int dirfd directory file descriptor, or `posix.fcntl.AT_FDCWD`
+@string path file to act on, relative to *dirfd* unless absolute
+@tparam[opt] table times with *atime* and *mtime* fields, each a
+  @{posix.time.PosixTimespec}; a missing field, or a *tv_nsec* of
+  `UTIME_NOW`, sets that time to the current time, and a *tv_nsec* of
+  `UTIME_OMIT` leaves it unchanged; if *times* is omitted, both are set
+  to the current time
+@int[opt=0] flags `0` or `posix.fcntl.AT_SYMLINK_NOFOLLOW`
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see utimensat(2)
+@usage
+  local sys_stat = require "posix.sys.stat"
+  -- update mtime only
+  sys_stat.utimensat(AT_FDCWD, path, {
+    atime = {tv_nsec = sys_stat.UTIME_OMIT},
+    mtime = {tv_sec = 1700000000, tv_nsec = 250000000},
+  })
+*/
+static int
+Putimensat(lua_State *L)
+{
+	struct timespec times[2];
+	int dirfd = checkint(L, 1);
+	const char *path = luaL_checkstring(L, 2);
+	int flags = optint(L, 4, 0);
+	checknargs(L, 4);
+	if (lua_isnoneornil(L, 3))
+		return pushresult(L, utimensat(dirfd, path, NULL, flags), path);
+
+	luaL_checktype(L, 3, LUA_TTABLE);
+	toutimensmember(L, 3, "atime", &times[0]);
+	toutimensmember(L, 3, "mtime", &times[1]);
+	checkfieldnames(L, 3, Sutimens_fields);
+	return pushresult(L, utimensat(dirfd, path, times, flags), path);
+}
+
 static const luaL_Reg posix_sys_stat_fns[] =
 {
 	LPOSIX_FUNC( PS_ISBLK		),
@@ -336,12 +833,20 @@ static const luaL_Reg posix_sys_stat_fns[] =
 	LPOSIX_FUNC( PS_ISREG		),
 	LPOSIX_FUNC( PS_ISSOCK		),
 	LPOSIX_FUNC( Pchmod		),
+	LPOSIX_FUNC( Pfchmodat	),
 	LPOSIX_FUNC( Plstat		),
 	LPOSIX_FUNC( Pfstat		),
+	LPOSIX_FUNC( Pfstatat	),
 	LPOSIX_FUNC( Pmkdir		),
+	LPOSIX_FUNC( Pmkdirat	),
 	LPOSIX_FUNC( Pmkfifo		),
 	LPOSIX_FUNC( Pstat		),
+	LPOSIX_FUNC( Pstatmany		),
+#if HAVE_STATX
+	LPOSIX_FUNC( Pstatx		),
+#endif
 	LPOSIX_FUNC( Pumask		),
+	LPOSIX_FUNC( Putimensat	),
 	{NULL, NULL}
 };
 
@@ -377,6 +882,25 @@ Any constants not available in the underlying system will be `nil` valued.
 @int S_IXOTH other execute
 @int S_ISGID set group id on execution
 @int S_ISUID set user id on execution
+@int UTIME_NOW set a @{utimensat} time to the current time
+@int UTIME_OMIT leave a @{utimensat} time unchanged
+@int AT_STATX_DONT_SYNC return cached attributes without synchronising
+@int AT_STATX_FORCE_SYNC synchronise attributes with a remote server
+@int AT_STATX_SYNC_AS_STAT synchronise as @{stat} would
+@int STATX_ALL all currently supported fields
+@int STATX_ATIME want *stx_atime*
+@int STATX_BASIC_STATS all the fields of a @{PosixStat}
+@int STATX_BLOCKS want *stx_blocks*
+@int STATX_BTIME want *stx_btime*
+@int STATX_CTIME want *stx_ctime*
+@int STATX_GID want *stx_gid*
+@int STATX_INO want *stx_ino*
+@int STATX_MODE want the permission bits of *stx_mode*
+@int STATX_MTIME want *stx_mtime*
+@int STATX_NLINK want *stx_nlink*
+@int STATX_SIZE want *stx_size*
+@int STATX_TYPE want the file type bits of *stx_mode*
+@int STATX_UID want *stx_uid*
 @usage
   -- Print stat constants supported on this host.
   for name, value in pairs (require "posix.sys.stat") do
@@ -394,6 +918,13 @@ luaopen_posix_sys_stat(lua_State *L)
 	lua_pushstring(L, LPOSIX_VERSION_STRING("sys.stat"));
 	lua_setfield(L, -2, "version");
 
+	luaL_newmetatable(L, STAT_HANDLE);
+	pushliteralfield("_type", "PosixStat");
+	luaL_newlib(L, statud_methods);
+	lua_pushcclosure(L, statud_index, 1);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+
 	LPOSIX_CONST( S_IFMT		);
 	LPOSIX_CONST( S_IFBLK		);
 	LPOSIX_CONST( S_IFCHR		);
@@ -416,6 +947,28 @@ luaopen_posix_sys_stat(lua_State *L)
 	LPOSIX_CONST( S_IXOTH		);
 	LPOSIX_CONST( S_ISGID		);
 	LPOSIX_CONST( S_ISUID		);
+	LPOSIX_CONST( UTIME_NOW	);
+	LPOSIX_CONST( UTIME_OMIT	);
+
+#if HAVE_STATX
+	LPOSIX_CONST( AT_STATX_DONT_SYNC	);
+	LPOSIX_CONST( AT_STATX_FORCE_SYNC	);
+	LPOSIX_CONST( AT_STATX_SYNC_AS_STAT	);
+	LPOSIX_CONST( STATX_ALL			);
+	LPOSIX_CONST( STATX_ATIME		);
+	LPOSIX_CONST( STATX_BASIC_STATS		);
+	LPOSIX_CONST( STATX_BLOCKS		);
+	LPOSIX_CONST( STATX_BTIME		);
+	LPOSIX_CONST( STATX_CTIME		);
+	LPOSIX_CONST( STATX_GID			);
+	LPOSIX_CONST( STATX_INO			);
+	LPOSIX_CONST( STATX_MODE		);
+	LPOSIX_CONST( STATX_MTIME		);
+	LPOSIX_CONST( STATX_NLINK		);
+	LPOSIX_CONST( STATX_SIZE		);
+	LPOSIX_CONST( STATX_TYPE		);
+	LPOSIX_CONST( STATX_UID			);
+#endif
 
 	return 1;
 }
@@ -0,0 +1,270 @@
+/*
+ * POSIX library for Lua 5.1, 5.2, 5.3 & 5.4.
+ * Copyright (C) 2013-2025 Gary V. Vaughan
+ * Copyright (C) 2010-2013 Reuben Thomas <rrt@sc3d.org>
+ * Copyright (C) 2008-2010 Natanael Copa <natanael.copa@gmail.com>
+ * Clean up and bug fixes by Leo Razoumov <slonik.az@gmail.com> 2006-10-11
+ * Luiz Henrique de Figueiredo <lhf@tecgraf.puc-rio.br> 07 Apr 2006 23:17:49
+ * Based on original by Claudio Terra for Lua 3.x.
+ * With contributions by Roberto Ierusalimschy.
+ * With documentation from Steve Donovan 2012
+ */
+/***
+ Timer Notification File Descriptors.
+
+ Where supported by the underlying system, functions to create timers
+ that deliver expirations through a file descriptor, so that they can
+ be waited on with @{posix.poll.poll} alongside other descriptors
+ rather than through `SIGALRM`.  If the module loads successfully, but
+ there is no system support, then `posix.sys.timerfd.version` will be
+ set, but the unsupported APIs will be `nil`.
+
+@module posix.sys.timerfd
+*/
+
+#include "_helpers.c"
+
+#if HAVE_SYS_TIMERFD_H && HAVE_TIMERFD_CREATE
+#include <stdint.h>
+#include <sys/timerfd.h>
+
+
+static const char *Sitimerspec_fields[] = { "it_interval", "it_value" };
+static const char *Sitimerspec_timespec_fields[] = { "tv_sec", "tv_nsec" };
+
+static void
+toitimerspec_member(lua_State *L, int index, const char *k, struct timespec *ts)
+{
+	int got_type, subindex;
+	lua_getfield(L, index, k);
+	got_type = lua_type(L, -1);
+	lua_pop(L, 1);
+	if (got_type == LUA_TNONE || got_type == LUA_TNIL)
+	{
+		ts->tv_sec = 0;
+		ts->tv_nsec = 0;
+		return;
+	}
+
+	/* Leaves the member table on the top of the stack. */
+	checkfieldtype(L, index, k, LUA_TTABLE, "table");
+	subindex = lua_gettop(L);
+	ts->tv_sec  = (time_t)optintegerfield(L, subindex, "tv_sec", 0);
+	ts->tv_nsec = optlongfield(L, subindex, "tv_nsec", 0);
+	checkfieldnames(L, subindex, Sitimerspec_timespec_fields);
+	lua_pop(L, 1);
+}
+
+static void
+toitimerspec(lua_State *L, int index, struct itimerspec *its)
+{
+	luaL_checktype(L, index, LUA_TTABLE);
+	toitimerspec_member(L, index, "it_interval", &its->it_interval);
+	toitimerspec_member(L, index, "it_value", &its->it_value);
+	checkfieldnames(L, index, Sitimerspec_fields);
+}
+
+
+static void
+pushitimerspec_member(lua_State *L, const char *k, struct timespec *ts)
+{
+	lua_createtable(L, 0, 2);
+	setintegerfield(ts, tv_sec);
+	setintegerfield(ts, tv_nsec);
+	settypemetatable("PosixTimespec");
+	lua_setfield(L, -2, k);
+}
+
+
+/***
+Interval timer specification.
+@table PosixItimerspec
+@tparam posix.time.PosixTimespec it_interval period of the timer after the
+  first expiration, or zero for a one-shot timer
+@tparam posix.time.PosixTimespec it_value time until the next expiration,
+  or zero if the timer is disarmed
+*/
+static int
+pushitimerspec(lua_State *L, struct itimerspec *its)
+{
+	if (!its)
+		return lua_pushnil(L), 1;
+
+	lua_createtable(L, 0, 2);
+	pushitimerspec_member(L, "it_interval", &its->it_interval);
+	pushitimerspec_member(L, "it_value", &its->it_value);
+
+	settypemetatable("PosixItimerspec");
+	return 1;
+}
+
+
+/***
+Create a timer that notifies via a file descriptor.
+@function timerfd_create
+@int clockid one of `posix.time.CLOCK_REALTIME`, `posix.time.CLOCK_MONOTONIC`
+  or `CLOCK_BOOTTIME`, where supported
+@int[opt=0] flags bitwise OR of zero or more of `TFD_CLOEXEC` and
+  `TFD_NONBLOCK`
+@treturn[1] int new file descriptor, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see timerfd_create(2)
+*/
+static int
+Ptimerfd_create(lua_State *L)
+{
+	int clockid = checkint(L, 1);
+	int flags = optint(L, 2, 0);
+	checknargs(L, 2);
+	return pushresult(L, timerfd_create(clockid, flags), "timerfd_create");
+}
+
+
+/***
+Fetch the current setting of a timer.
+@function timerfd_gettime
+@int fd file descriptor returned by @{timerfd_create}
+@treturn[1] PosixItimerspec time until next expiration and interval, if
+  successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see timerfd_gettime(2)
+*/
+static int
+Ptimerfd_gettime(lua_State *L)
+{
+	struct itimerspec curr;
+	int fd = checkint(L, 1);
+	checknargs(L, 1);
+	if (timerfd_gettime(fd, &curr) == -1)
+		return pusherror(L, "timerfd_gettime");
+	return pushitimerspec(L, &curr);
+}
+
+
+/***
+Arm or disarm a timer.
+With `TFD_TIMER_ABSTIME`, *it_value* is an absolute time on the clock
+passed to @{timerfd_create}, such as a deadline computed from
+@{posix.time.clock_gettime}(`CLOCK_MONOTONIC`).
+@function timerfd_settime
+@int fd file descriptor returned by @{timerfd_create}
+@int flags `0`, or a bitwise OR of `TFD_TIMER_ABSTIME` and
+  `TFD_TIMER_CANCEL_ON_SET`
+@tparam PosixItimerspec new_value new setting, where a zero *it_value*
+  disarms the timer
+@treturn[1] PosixItimerspec previous setting, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see timerfd_settime(2)
+@usage
+  local timerfd = require "posix.sys.timerfd"
+  local time = require "posix.time"
+  local tfd = timerfd.timerfd_create(time.CLOCK_MONOTONIC)
+  -- first expiration in 1.5 seconds, then every 250 milliseconds
+  timerfd.timerfd_settime(tfd, 0, {
+    it_value = {tv_sec = 1, tv_nsec = 500000000},
+    it_interval = {tv_nsec = 250000000},
+  })
+*/
+static int
+Ptimerfd_settime(lua_State *L)
+{
+	struct itimerspec new_value, old_value;
+	int fd = checkint(L, 1);
+	int flags = checkint(L, 2);
+	toitimerspec(L, 3, &new_value);
+	checknargs(L, 3);
+	if (timerfd_settime(fd, flags, &new_value, &old_value) == -1)
+		return pusherror(L, "timerfd_settime");
+	return pushitimerspec(L, &old_value);
+}
+
+
+/***
+Wait for a timer to expire.
+Reads the 8-byte expiration counter from *fd*, which is reset to zero.
+Fails with `EAGAIN` if there have been no expirations since the last
+read and *fd* was created with `TFD_NONBLOCK`.
+@function timerfd_read
+@int fd file descriptor returned by @{timerfd_create}
+@treturn[1] int number of expirations since the last read, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see timerfd_create(2)
+*/
+static int
+Ptimerfd_read(lua_State *L)
+{
+	uint64_t expirations;
+	int fd = checkint(L, 1);
+	checknargs(L, 1);
+	if (read(fd, &expirations, sizeof expirations) != sizeof expirations)
+		return pusherror(L, "timerfd_read");
+	return pushintegerresult(expirations);
+}
+#endif
+
+
+static const luaL_Reg posix_sys_timerfd_fns[] =
+{
+#if HAVE_SYS_TIMERFD_H && HAVE_TIMERFD_CREATE
+	LPOSIX_FUNC( Ptimerfd_create	),
+	LPOSIX_FUNC( Ptimerfd_gettime	),
+	LPOSIX_FUNC( Ptimerfd_read	),
+	LPOSIX_FUNC( Ptimerfd_settime	),
+#endif
+	{NULL, NULL}
+};
+
+
+/***
+Constants.
+@section constants
+*/
+
+/***
+Timerfd constants.
+Any constants not available in the underlying system will be `nil` valued.
+@table posix.sys.timerfd
+@int CLOCK_BOOTTIME monotonic clock that includes time spent in suspend
+@int TFD_CLOEXEC close the new file descriptor on exec
+@int TFD_NONBLOCK reads fail with `EAGAIN` instead of blocking
+@int TFD_TIMER_ABSTIME interpret *it_value* as an absolute time
+@int TFD_TIMER_CANCEL_ON_SET fail reads with `ECANCELED` if a realtime clock
+  is set discontinuously
+@usage
+  -- Print timerfd constants supported on this host.
+  for name, value in pairs (require "posix.sys.timerfd") do
+    if type (value) == "number" then
+      print (name, value)
+     end
+  end
+*/
+
+LUALIB_API int
+luaopen_posix_sys_timerfd(lua_State *L)
+{
+	luaL_newlib(L, posix_sys_timerfd_fns);
+	lua_pushstring(L, LPOSIX_VERSION_STRING("sys.timerfd"));
+	lua_setfield(L, -2, "version");
+
+#if HAVE_SYS_TIMERFD_H && HAVE_TIMERFD_CREATE
+#  ifdef CLOCK_BOOTTIME
+	LPOSIX_CONST( CLOCK_BOOTTIME		);
+#  endif
+	LPOSIX_CONST( TFD_CLOEXEC		);
+	LPOSIX_CONST( TFD_NONBLOCK		);
+	LPOSIX_CONST( TFD_TIMER_ABSTIME		);
+#  ifdef TFD_TIMER_CANCEL_ON_SET
+	LPOSIX_CONST( TFD_TIMER_CANCEL_ON_SET	);
+#  endif
+#endif
+
+	return 1;
+}
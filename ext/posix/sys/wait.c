@@ -15,21 +15,65 @@
 @module posix.sys.wait
 */
 
+#include "_helpers.c"	/* for _GNU_SOURCE, needed by P_PIDFD */
+
+#include <signal.h>
 #include <sys/wait.h>
 
-#include "_helpers.c"
+#include "_rusage.c"
+
+
+/* Push the pid and decoded *status* returned by waitpid or wait4. */
+static int
+pushwaitstatus(lua_State *L, pid_t pid, int status)
+{
+	lua_pushinteger(L, pid);
+	if (pid == 0)
+	{
+		lua_pushliteral(L,"running");
+		return 2;
+	}
+	else if (WIFEXITED(status))
+	{
+		lua_pushliteral(L,"exited");
+		lua_pushinteger(L, WEXITSTATUS(status));
+		return 3;
+	}
+	else if (WIFSIGNALED(status))
+	{
+		lua_pushliteral(L,"killed");
+		lua_pushinteger(L, WTERMSIG(status));
+		return 3;
+	}
+	else if (WIFSTOPPED(status))
+	{
+		lua_pushliteral(L,"stopped");
+		lua_pushinteger(L, WSTOPSIG(status));
+		return 3;
+	}
+#ifdef WIFCONTINUED
+	else if (WIFCONTINUED(status))
+	{
+		lua_pushliteral(L,"continued");
+		lua_pushinteger(L, SIGCONT);
+		return 3;
+	}
+#endif
+	return 1;
+}
 
 
 /***
 Wait for child process to terminate.
 @function wait
 @int[opt=-1] pid child process id to wait for, or -1 for any child process
-@int[opt] options bitwise OR of `WNOHANG` and `WUNTRACED`
+@int[opt] options bitwise OR of `WNOHANG`, `WUNTRACED` and `WCONTINUED`
 @treturn[1] int pid of running child, if not exited yet and called with `WNOHANG`
 @treturn[1] string "running"
 @treturn[2] int pid of terminated child, if successful
-@treturn[2] string "exited", "killed" or "stopped"
-@treturn[2] int exit status, or signal number responsible for "killed" or "stopped"
+@treturn[2] string "exited", "killed", "stopped" or "continued"
+@treturn[2] int exit status, or signal number responsible for "killed",
+  "stopped" or "continued"
 @return[3] nil
 @treturn[3] string error message
 @treturn[3] int errnum
@@ -47,37 +91,160 @@ Pwait(lua_State *L)
 	pid = waitpid(pid, &status, options);
 	if (pid == -1)
 		return pusherror(L, NULL);
-	lua_pushinteger(L, pid);
-	if (pid == 0)
+	return pushwaitstatus(L, pid, status);
+}
+
+
+#if HAVE_WAIT4
+/***
+Wait for child process to terminate, and fetch its resource usage.
+Like @{wait}, but also returns the resources used by the child and all
+of its reaped descendants, which are not otherwise available once the
+child has been reaped.
+@function wait4
+@int[opt=-1] pid child process id to wait for, or -1 for any child process
+@int[opt] options bitwise OR of `WNOHANG`, `WUNTRACED` and `WCONTINUED`
+@treturn[1] int pid of running child, if not exited yet and called with `WNOHANG`
+@treturn[1] string "running"
+@treturn[2] int pid of terminated child, if successful
+@treturn[2] string "exited", "killed", "stopped" or "continued"
+@treturn[2] int exit status, or signal number responsible for "killed",
+  "stopped" or "continued"
+@treturn[2] posix.sys.resource.PosixRusage resources used by the child
+@return[3] nil
+@treturn[3] string error message
+@treturn[3] int errnum
+@see wait4(2)
+@usage
+  local wait = require "posix.sys.wait"
+  local pid, reason, status, ru = wait.wait4 (child)
+  bill (job, ru.ru_utime.tv_sec + ru.ru_stime.tv_sec, ru.ru_maxrss)
+*/
+static int
+Pwait4(lua_State *L)
+{
+	int status = 0, n;
+	struct rusage ru;
+	pid_t pid = (pid_t)optinteger(L, 1, -1);
+	int options = optint(L, 2, 0);
+	checknargs(L, 2);
+
+	pid = wait4(pid, &status, options, &ru);
+	if (pid == -1)
+		return pusherror(L, NULL);
+	n = pushwaitstatus(L, pid, status);
+	if (n < 3)
+		return n;
+	return n + pushrusage(L, &ru);
+}
+#endif
+
+
+/***
+Child process state change information.
+@table PosixSiginfo
+@int si_pid process id of the child
+@int si_uid real user id of the child
+@int si_signo always `SIGCHLD`
+@int si_code one of `CLD_EXITED`, `CLD_KILLED`, `CLD_DUMPED`,
+  `CLD_STOPPED`, `CLD_TRAPPED` or `CLD_CONTINUED`
+@int si_status exit status for `CLD_EXITED`, otherwise the signal that
+  caused the change of state
+*/
+static void
+pushsiginfo(lua_State *L, siginfo_t *info)
+{
+	/* si_* are macros on glibc, so assign field name strings manually. */
+	lua_createtable(L, 0, 5);
+	pushintegerfield("si_pid", info->si_pid);
+	pushintegerfield("si_uid", info->si_uid);
+	pushintegerfield("si_signo", info->si_signo);
+	pushintegerfield("si_code", info->si_code);
+	pushintegerfield("si_status", info->si_status);
+	settypemetatable("PosixSiginfo");
+}
+
+
+/***
+Wait for a change of state in a child process, selected by id type.
+Like @{wait}, but *idtype* selects whether *id* is a process id, a
+process group id or, on Linux, a pidfd from @{posix.sys.pidfd}.  Waiting
+on a pidfd cannot pick up an unrelated process that has reused the
+process id.  With `WNOWAIT`, the child is left waitable, so that its
+state can be inspected before another call reaps it.
+@function waitid
+@int idtype one of `P_ALL`, `P_PID`, `P_PGID` or `P_PIDFD`
+@int[opt=0] id process id, process group id or pidfd, ignored for `P_ALL`
+@int[opt=WEXITED] options bitwise OR of at least one of `WEXITED`,
+  `WSTOPPED` and `WCONTINUED`, and zero or more of `WNOHANG` and `WNOWAIT`
+@treturn[1] int `0`, if no child has changed state yet and called with
+  `WNOHANG`
+@treturn[1] string "running"
+@treturn[2] int pid of child, if successful
+@treturn[2] string "exited", "killed", "stopped" or "continued"
+@treturn[2] int exit status, or signal number responsible for "killed",
+  "stopped" or "continued"
+@treturn[2] PosixSiginfo details of the change of state
+@return[3] nil
+@treturn[3] string error message
+@treturn[3] int errnum
+@see waitid(2)
+@usage
+  local wait = require "posix.sys.wait"
+  -- reap the child whose pidfd poll reported readable
+  local pid, reason, status = wait.waitid (wait.P_PIDFD, pfd)
+*/
+static int
+Pwaitid(lua_State *L)
+{
+	siginfo_t info;
+	idtype_t idtype = (idtype_t)checkint(L, 1);
+	id_t id = (id_t)optinteger(L, 2, 0);
+	int options = optint(L, 3, WEXITED);
+	checknargs(L, 3);
+
+	/* With WNOHANG, si_pid stays 0 if no child has changed state. */
+	memset(&info, 0, sizeof info);
+	if (waitid(idtype, id, &info, options) == -1)
+		return pusherror(L, NULL);
+	lua_pushinteger(L, info.si_pid);
+	if (info.si_pid == 0)
 	{
 		lua_pushliteral(L,"running");
 		return 2;
 	}
-	else if (WIFEXITED(status))
+	switch (info.si_code)
 	{
-		lua_pushliteral(L,"exited");
-		lua_pushinteger(L, WEXITSTATUS(status));
-		return 3;
+		case CLD_EXITED:
+			lua_pushliteral(L,"exited");
+			break;
+		case CLD_KILLED:
+		case CLD_DUMPED:
+			lua_pushliteral(L,"killed");
+			break;
+		case CLD_STOPPED:
+		case CLD_TRAPPED:
+			lua_pushliteral(L,"stopped");
+			break;
+		case CLD_CONTINUED:
+			lua_pushliteral(L,"continued");
+			break;
+		default:
+			return 1;
 	}
-	else if (WIFSIGNALED(status))
-	{
-		lua_pushliteral(L,"killed");
-		lua_pushinteger(L, WTERMSIG(status));
-		return 3;
-	}
-	else if (WIFSTOPPED(status))
-	{
-		lua_pushliteral(L,"stopped");
-		lua_pushinteger(L, WSTOPSIG(status));
-		return 3;
-	}
-	return 1;
+	lua_pushinteger(L, info.si_status);
+	pushsiginfo(L, &info);
+	return 4;
 }
 
 
 static const luaL_Reg posix_sys_wait_fns[] =
 {
 	LPOSIX_FUNC( Pwait		),
+#if HAVE_WAIT4
+	LPOSIX_FUNC( Pwait4		),
+#endif
+	LPOSIX_FUNC( Pwaitid		),
 	{NULL, NULL}
 };
 
@@ -91,7 +258,21 @@ Constants.
 Wait constants.
 Any constants not available in the underlying system will be `nil` valued.
 @table posix.sys.wait
+@int CLD_CONTINUED stopped child has continued
+@int CLD_DUMPED child was killed, and dumped core
+@int CLD_EXITED child has exited
+@int CLD_KILLED child was killed
+@int CLD_STOPPED child has stopped
+@int CLD_TRAPPED traced child has trapped
+@int P_ALL wait for any child
+@int P_PGID wait for any child in a process group
+@int P_PID wait for the child with a process id
+@int P_PIDFD wait for the child referred to by a pidfd
+@int WEXITED report status of terminated children
+@int WCONTINUED report status of stopped children continued by `SIGCONT`
 @int WNOHANG don't block waiting
+@int WNOWAIT leave the child waitable, for @{waitid}
+@int WSTOPPED report status of stopped children, for @{waitid}
 @int WUNTRACED report status of stopped children
 @usage
   -- Print wait constants supported on this host.
@@ -110,7 +291,25 @@ luaopen_posix_sys_wait(lua_State *L)
 	lua_pushstring(L, LPOSIX_VERSION_STRING("sys.wait"));
 	lua_setfield(L, -2, "version");
 
+	LPOSIX_CONST( CLD_CONTINUED	);
+	LPOSIX_CONST( CLD_DUMPED	);
+	LPOSIX_CONST( CLD_EXITED	);
+	LPOSIX_CONST( CLD_KILLED	);
+	LPOSIX_CONST( CLD_STOPPED	);
+	LPOSIX_CONST( CLD_TRAPPED	);
+	LPOSIX_CONST( P_ALL		);
+	LPOSIX_CONST( P_PGID		);
+	LPOSIX_CONST( P_PID		);
+#if HAVE_DECL_P_PIDFD
+	LPOSIX_CONST( P_PIDFD		);
+#endif
+	LPOSIX_CONST( WEXITED		);
+#ifdef WCONTINUED
+	LPOSIX_CONST( WCONTINUED	);
+#endif
 	LPOSIX_CONST( WNOHANG		);
+	LPOSIX_CONST( WNOWAIT		);
+	LPOSIX_CONST( WSTOPPED		);
 	LPOSIX_CONST( WUNTRACED		);
 
 	return 1;
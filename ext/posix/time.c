@@ -15,6 +15,7 @@
 @module posix.time
 */
 
+#include <stdint.h>
 #include <sys/time.h>
 #include <time.h>
 
@@ -130,6 +131,25 @@ pushtm(lua_State *L, struct tm *t)
 }
 
 
+/* Nanosecond counts are computed in 64 bits, and exchanged with Lua as
+   lua_Number wherever lua_Integer is narrower: ptrdiff_t on ILP32 with
+   Lua 5.1 and 5.2, or Lua 5.3 and 5.4 built with 32-bit integers. */
+#define timespec_ns(ts) ((int64_t)(ts).tv_sec * 1000000000 + (ts).tv_nsec)
+
+#if defined LUA_MAXINTEGER
+#  define LPOSIX_WIDE_INTEGER (LUA_MAXINTEGER >= INT64_MAX)
+#else
+#  define LPOSIX_WIDE_INTEGER (PTRDIFF_MAX >= INT64_MAX)
+#endif
+
+#if LPOSIX_WIDE_INTEGER
+#  define pushns(L, n)	lua_pushinteger(L, (lua_Integer)(n))
+#  define tons(L, i)	((int64_t)lua_tointeger(L, i))
+#else
+#  define pushns(L, n)	lua_pushnumber(L, (lua_Number)(n))
+#  define tons(L, i)	((int64_t)lua_tonumber(L, i))
+#endif
+
 #if defined _POSIX_TIMERS && _POSIX_TIMERS != -1
 /***
 Find the precision of a clock.
@@ -175,6 +195,242 @@ Pclock_gettime(lua_State *L)
 		return pusherror(L, "clock_gettime");
 	return pushtimespec(L, &ts);
 }
+
+
+/***
+Read a clock as integer nanoseconds.
+Unlike @{clock_gettime}, no table is allocated, so this is suitable for
+reading a clock at very high rates.  On Lua 5.1 and 5.2, where every
+number is a double, and on Lua 5.3 or 5.4 builds with integers narrower
+than 64 bits, where the result is returned as a float, nanosecond values
+beyond 2^53 (for instance `CLOCK_REALTIME`) lose precision in the least
+significant digits.
+@function clock_gettime_ns
+@int clk name of clock, one of `CLOCK_REALTIME`, `CLOCK_PROCESS_CPUTIME_ID`,
+  `CLOCK_MONOTONIC` or `CLOCK_THREAD_CPUTIME_ID`
+@treturn[1] int current value of *clk* in nanoseconds, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see clock_gettime(3)
+*/
+static int
+Pclock_gettime_ns(lua_State *L)
+{
+	struct timespec ts;
+	int clk = checkint(L, 1);
+	checknargs(L, 1);
+	if (clock_gettime(clk, &ts) == -1)
+		return pusherror(L, "clock_gettime");
+	return (pushns(L, timespec_ns(ts)), 1);
+}
+
+
+#if defined CLOCK_MONOTONIC
+/***
+Read the monotonic clock as integer nanoseconds.
+Equivalent to `clock_gettime_ns(CLOCK_MONOTONIC)`.
+@function now_ns
+@treturn[1] int nanoseconds since an unspecified starting point, if
+  successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see clock_gettime_ns
+@usage
+  local t0 = now_ns()
+  work()
+  print(now_ns() - t0 .. "ns")
+*/
+static int
+Pnow_ns(lua_State *L)
+{
+	struct timespec ts;
+	checknargs(L, 0);
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		return pusherror(L, "clock_gettime");
+	return (pushns(L, timespec_ns(ts)), 1);
+}
+
+
+/***
+Nanoseconds elapsed on the monotonic clock since one or more start times.
+The clock is read only once, however many start times are passed.
+@function elapsed
+@int t0 start time from @{now_ns}
+@int ... further start times
+@treturn[1] int nanoseconds elapsed since *t0*, followed by one result
+  per additional start time, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@usage
+  local t_req = now_ns()
+  local t_db = now_ns()
+  query()
+  local req_ns, db_ns = elapsed(t_req, t_db)
+*/
+static int
+Pelapsed(lua_State *L)
+{
+	struct timespec ts;
+	int64_t now;
+	int i, n = lua_gettop(L);
+	checkinteger(L, 1);
+	for (i = 2; i <= n; i++)
+		checkinteger(L, i);
+	luaL_checkstack(L, n, "too many arguments");
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		return pusherror(L, "clock_gettime");
+	now = timespec_ns(ts);
+	for (i = 1; i <= n; i++)
+		pushns(L, now - tons(L, i));
+	return n;
+}
+#endif
+#endif
+
+
+#if HAVE_CLOCK_NANOSLEEP
+/***
+Sleep with nanosecond precision against a specific clock.
+With `TIMER_ABSTIME`, sleep until *clk* reaches the absolute time *ts*,
+which lets periodic loops compute each deadline from the last one
+without accumulating drift.
+@function clock_nanosleep
+@int clk name of clock, one of `CLOCK_REALTIME` or `CLOCK_MONOTONIC`
+@int flags `0` for a relative sleep, or `TIMER_ABSTIME`
+@tparam PosixTimespec ts requested sleep time or absolute deadline
+@treturn[1] int `0` if requested time has elapsed, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@treturn[2] PosixTimespec unslept time remaining, if a relative sleep
+  was interrupted
+@see clock_nanosleep(2)
+@see nanosleep
+*/
+static int
+Pclock_nanosleep(lua_State *L)
+{
+	struct timespec req;
+	struct timespec rem;
+	int clk = checkint(L, 1);
+	int flags = checkint(L, 2);
+	int r;
+
+	totimespec(L, 3, &req);
+	checknargs(L, 3);
+	if ((r = clock_nanosleep(clk, flags, &req, &rem)) != 0)
+	{
+		errno = r;
+		r = pusherror(L, "clock_nanosleep");
+		if (errno == EINTR && !(flags & TIMER_ABSTIME))
+			r = r + pushtimespec(L, &rem);
+		return r;
+	}
+	return pushintegerresult(0);
+}
+
+
+#define TICKER_HANDLE	PACKAGE " ticker"
+
+typedef struct
+{
+	struct timespec	next;
+	lua_Integer	period;
+	int		clk;
+} ticker;
+
+
+/***
+Sleep until the next tick of a periodic ticker.
+The ticker sleeps to absolute deadlines, so that time spent between
+calls does not accumulate as drift.  If the caller falls behind by one
+or more whole periods, the missed ticks are skipped and counted rather
+than delivered in a burst.
+@function wait
+@treturn[1] int number of ticks missed since the previous call, if
+  successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@usage
+  local t = ticker(100000) -- 10 kHz
+  while true do
+    local overruns = t:wait()
+    sample()
+  end
+*/
+static int
+ticker_wait(lua_State *L)
+{
+	ticker *t = (ticker *)luaL_checkudata(L, 1, TICKER_HANDLE);
+	struct timespec now;
+	int64_t late, overruns = 0;
+	int r;
+	checknargs(L, 1);
+
+	while ((r = clock_nanosleep(t->clk, TIMER_ABSTIME, &t->next, NULL)) == EINTR)
+		;
+	if (r != 0)
+	{
+		errno = r;
+		return pusherror(L, "clock_nanosleep");
+	}
+	if (clock_gettime(t->clk, &now) == -1)
+		return pusherror(L, "clock_gettime");
+
+	late = timespec_ns(now) - timespec_ns(t->next);
+	if (late >= t->period)
+		overruns = late / t->period;
+	late = t->next.tv_nsec + (overruns + 1) * t->period;
+	t->next.tv_sec += late / 1000000000;
+	t->next.tv_nsec = late % 1000000000;
+	return pushintegerresult(overruns);
+}
+
+
+/***
+Create a periodic ticker.
+@function ticker
+@int period interval between ticks in nanoseconds
+@int[opt=CLOCK_MONOTONIC] clk name of clock to tick against
+@return[1] a ticker object, whose first tick is one *period* from now
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see wait
+*/
+static int
+Pticker(lua_State *L)
+{
+	lua_Integer period = checkinteger(L, 1);
+	int clk = optint(L, 2, CLOCK_MONOTONIC);
+	ticker *t;
+	lua_Integer next;
+	checknargs(L, 2);
+	luaL_argcheck(L, period > 0, 1, "period must be positive");
+
+	t = (ticker *)lua_newuserdata(L, sizeof *t);
+	if (clock_gettime(clk, &t->next) == -1)
+		return pusherror(L, "clock_gettime");
+	next = t->next.tv_nsec + period;
+	t->next.tv_sec += next / 1000000000;
+	t->next.tv_nsec = next % 1000000000;
+	t->period = period;
+	t->clk = clk;
+
+	if (luaL_newmetatable(L, TICKER_HANDLE))
+	{
+		lua_newtable(L);
+		lua_pushcfunction(L, ticker_wait);
+		lua_setfield(L, -2, "wait");
+		lua_setfield(L, -2, "__index");
+	}
+	lua_setmetatable(L, -2);
+	return 1;
+}
 #endif
 
 
@@ -356,6 +612,15 @@ static const luaL_Reg posix_time_fns[] =
 #if defined _POSIX_TIMERS && _POSIX_TIMERS != -1
 	LPOSIX_FUNC( Pclock_getres	),
 	LPOSIX_FUNC( Pclock_gettime	),
+	LPOSIX_FUNC( Pclock_gettime_ns	),
+#  if defined CLOCK_MONOTONIC
+	LPOSIX_FUNC( Pelapsed		),
+	LPOSIX_FUNC( Pnow_ns		),
+#  endif
+#endif
+#if HAVE_CLOCK_NANOSLEEP
+	LPOSIX_FUNC( Pclock_nanosleep	),
+	LPOSIX_FUNC( Pticker		),
 #endif
 	LPOSIX_FUNC( Pgmtime		),
 	LPOSIX_FUNC( Plocaltime		),
@@ -381,6 +646,7 @@ Any constants not available in the underlying system will be `nil` valued.
 @int CLOCK_PROCESS_CPUTIME_ID the identifier for the current process CPU-time clock
 @int CLOCK_REALTIME the identifier for the system-wide realtime clock
 @int CLOCK_THREAD_CPUTIME_ID the identifier for the current thread CPU-time clock
+@int TIMER_ABSTIME treat the @{clock_nanosleep} time as an absolute deadline
 @usage
   -- Print posix.time constants supported on this host.
   for name, value in pairs (require "posix.time") do
@@ -409,6 +675,9 @@ luaopen_posix_time(lua_State *L)
 #if defined CLOCK_THREAD_CPUTIME_ID
 	LPOSIX_CONST( CLOCK_THREAD_CPUTIME_ID	);
 #endif
+#if HAVE_CLOCK_NANOSLEEP
+	LPOSIX_CONST( TIMER_ABSTIME		);
+#endif
 
 	return 1;
 }
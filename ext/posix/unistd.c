@@ -18,16 +18,58 @@
 @module posix.unistd
 */
 
+#include "_helpers.c"	/* for _GNU_SOURCE, needed by SEEK_DATA */
+
 #if HAVE_CRYPT_H
 #  include <crypt.h>
 #endif
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <grp.h>
+#include <limits.h>
 #include <pwd.h>
 #include <unistd.h>
 
-#include "_helpers.c"
+#ifndef IOV_MAX
+#  define IOV_MAX 1024
+#endif
+
+
+/* Collect the string, or list of strings, at narg into an iovec array
+   left in a new userdata on top of the stack, so call this only after
+   checking the other arguments.  The iovecs point into the
+   strings, which are kept alive by the argument for the rest of the
+   call. */
+static struct iovec *
+checkiovec(lua_State *L, int narg, int *niov)
+{
+	struct iovec *iov;
+	int i, n;
+	if (lua_type(L, narg) == LUA_TSTRING)
+	{
+		iov = (struct iovec *)lua_newuserdata(L, sizeof *iov);
+		iov->iov_base = (void *)lua_tolstring(L, narg, &iov->iov_len);
+		*niov = 1;
+		return iov;
+	}
+	if (lua_type(L, narg) != LUA_TTABLE)
+		argtypeerror(L, narg, "string or table");
+	n = (int)lua_rawlen(L, narg);
+	iov = (struct iovec *)lua_newuserdata(L, (n ? n : 1) * sizeof *iov);
+	for (i = 0; i < n; i++)
+	{
+		lua_rawgeti(L, narg, i + 1);
+		if (lua_type(L, -1) != LUA_TSTRING)
+			luaL_argerror(L, narg, lua_pushfstring(L,
+				"string expected at index %d, got %s", i + 1, luaL_typename(L, -1)));
+		iov[i].iov_base = (void *)lua_tolstring(L, -1, &iov[i].iov_len);
+		lua_pop(L, 1);
+	}
+	*niov = n;
+	return iov;
+}
 
 static uid_t
 mygetuid(lua_State *L, int i)
@@ -179,6 +221,36 @@ Pchown(lua_State *L)
 }
 
 
+/***
+Change ownership of a file relative to a directory descriptor.
+@function fchownat
+@int dirfd directory that a relative *path* is resolved against, or
+  `posix.fcntl.AT_FDCWD`
+@string path existing file path
+@tparam string|int uid new owner user id
+@tparam string|int gid new owner group id
+@int[opt=0] flags `0`, or `posix.fcntl.AT_SYMLINK_NOFOLLOW` to change a
+  symbolic link itself
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see fchownat(2)
+@see chown
+*/
+static int
+Pfchownat(lua_State *L)
+{
+	int dirfd = checkint(L, 1);
+	const char *path = luaL_checkstring(L, 2);
+	uid_t uid = mygetuid(L, 3);
+	gid_t gid = mygetgid(L, 4);
+	int flags = optint(L, 5, 0);
+	checknargs(L, 5);
+	return pushresult(L, fchownat(dirfd, path, uid, gid, flags), path);
+}
+
+
 /***
 Close an open file descriptor.
 @function close
@@ -202,6 +274,81 @@ Pclose(lua_State *L)
 }
 
 
+/***
+Write a batch of buffers, then make them durable with a single flush.
+Every buffer is written in order, with as few `writev` calls as
+possible, resuming after any partial write; then *fd* is flushed once
+with @{fdatasync} (or @{fsync}, where `fdatasync` is unavailable).
+Batching the records of many requests into one call spreads the cost
+of the flush across all of them.
+@function commit
+@int fd file descriptor to write to
+@tparam string|table bufs a string, or list of strings to write in order
+@int[opt] offset if given, write at this offset without changing the file
+  position, otherwise write at the current file position
+@treturn[1] int total number of bytes written, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see writev(2)
+@see fdatasync(2)
+@usage
+  local unistd = require "posix.unistd"
+  -- append every queued record, then acknowledge them all at once
+  local n, errmsg = unistd.commit (logfd, queue)
+*/
+static int
+Pcommit(lua_State *L)
+{
+	int fd = checkint(L, 1);
+	int positioned = !lua_isnoneornil(L, 3);
+	off_t offset = (off_t)optinteger(L, 3, 0);
+	lua_Integer done = 0;
+	int niov, i = 0;
+	struct iovec *iov;
+	checknargs(L, 3);
+	iov = checkiovec(L, 2, &niov);
+
+	while (i < niov)
+	{
+		int cnt = niov - i < IOV_MAX ? niov - i : IOV_MAX;
+		ssize_t n;
+		if (!positioned)
+			n = writev(fd, iov + i, cnt);
+		else
+#if HAVE_PWRITEV
+			n = pwritev(fd, iov + i, cnt, offset + done);
+#else
+			n = ((void)offset, errno = ENOTSUP, -1);
+#endif
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return pusherror(L, "commit");
+		}
+		done += n;
+
+		/* Skip buffers written in full, and trim a partially written one. */
+		for (; i < niov && (size_t)n >= iov[i].iov_len; i++)
+			n -= iov[i].iov_len;
+		if (n > 0)
+		{
+			iov[i].iov_base = (char *)iov[i].iov_base + n;
+			iov[i].iov_len -= n;
+		}
+	}
+
+#if HAVE_FDATASYNC
+	if (fdatasync(fd) == -1)
+#else
+	if (fsync(fd) == -1)
+#endif
+		return pusherror(L, "commit");
+	return pushintegerresult(done);
+}
+
+
 #if defined HAVE_CRYPT
 /***
 Encrypt a password.
@@ -825,17 +972,48 @@ Plinkat(lua_State *L)
 }
 
 
+/***
+Create a symbolic link relative to a directory descriptor.
+@function symlinkat
+@string target contents of the new link
+@int linkdir directory that a relative *link* is resolved against, or
+  `posix.fcntl.AT_FDCWD`
+@string link name
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see symlinkat(2)
+@see link
+*/
+static int
+Psymlinkat(lua_State *L)
+{
+	const char *target = luaL_checkstring(L, 1);
+	int newdirfd = checkint(L, 2);
+	const char *linkpath = luaL_checkstring(L, 3);
+	checknargs(L, 3);
+	return pushresult(L, symlinkat(target, newdirfd, linkpath), NULL);
+}
+
+
 /***
 reposition read/write file offset
 @function lseek
 @int fd open file descriptor to act on
 @int offset bytes to seek
-@int whence one of `SEEK_SET`, `SEEK_CUR` or `SEEK_END`
+@int whence one of `SEEK_SET`, `SEEK_CUR` or `SEEK_END` (or `SEEK_DATA`
+  and `SEEK_HOLE`, where supported)
 @treturn[1] int new offset, if successful
 @return[2] nil
 @treturn[2] string error message
 @treturn[2] int errnum
 @see lseek(2)
+@usage
+  -- find the first data extent in a sparse file
+  local unistd = require "posix.unistd"
+  local start = unistd.lseek(fd, 0, unistd.SEEK_DATA)
+  local stop = start and unistd.lseek(fd, start, unistd.SEEK_HOLE)
 */
 static int
 Plseek(lua_State *L)
@@ -898,6 +1076,7 @@ Creates a pipe.
 @treturn[2] string error message
 @treturn[2] int errnum
 @see pipe(2)
+@see pipe2
 @see fork.lua
 */
 static int
@@ -915,6 +1094,112 @@ Ppipe(lua_State *L)
 }
 
 
+#if HAVE_PIPE2
+/***
+Creates a pipe, with flags.
+Unlike calling @{posix.fcntl.fcntl} after @{pipe}, the flags are set
+atomically, so that with `O_CLOEXEC` no concurrently forked child can
+inherit the pipe.  In `O_DIRECT` packet mode, each @{write} of up to
+`PIPE_BUF` bytes is a separate packet, and each @{read} returns at most
+one packet, so readers never see a partial message.  The capacity of
+the new pipe can be changed with `F_SETPIPE_SZ`.
+@function pipe2
+@int[opt=0] flags bitwise OR of zero or more of `O_CLOEXEC`,
+  `O_NONBLOCK` and `O_DIRECT`, from @{posix.fcntl}
+@treturn[1] int read end file descriptor
+@treturn[1] int write end file descriptor, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see pipe2(2)
+@usage
+  local fcntl = require "posix.fcntl"
+  local r, w = unistd.pipe2(bit.bor(fcntl.O_CLOEXEC, fcntl.O_NONBLOCK))
+  fcntl.fcntl(w, fcntl.F_SETPIPE_SZ, 1048576)
+*/
+static int
+Ppipe2(lua_State *L)
+{
+	int pipefd[2];
+	int flags = optint(L, 1, 0);
+	checknargs(L, 1);
+	if (pipe2(pipefd, flags) == -1)
+		return pusherror(L, "pipe2");
+	lua_pushinteger(L, pipefd[0]);
+	lua_pushinteger(L, pipefd[1]);
+	return 2;
+}
+#endif
+
+
+#ifdef FIONREAD
+/***
+Number of bytes that can be read without blocking.
+Works for pipes, sockets and terminals, so a reader can wait until a
+whole message has arrived before calling @{read}.
+@function fionread
+@int fd file descriptor to query
+@treturn[1] int number of bytes immediately available, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see ioctl(2)
+*/
+static int
+Pfionread(lua_State *L)
+{
+	int fd = checkint(L, 1);
+	int n = 0;
+	checknargs(L, 1);
+	if (ioctl(fd, FIONREAD, &n) == -1)
+		return pusherror(L, NULL);
+	return pushintegerresult(n);
+}
+#endif
+
+
+#if HAVE_PWRITEV2
+/***
+Write a list of buffers at an offset, with per-call flags.
+Unlike @{write}, the buffers are passed to the kernel in one system call,
+which may write fewer bytes than were given.  Passing `RWF_DSYNC` makes
+just this write durable, as if *fd* had been opened with `O_DSYNC`,
+without a separate call to @{fdatasync}.
+@function pwritev2
+@int fd file descriptor to write to
+@tparam string|table bufs a string, or list of strings to write in order
+@int[opt=-1] offset file offset to write at, or `-1` to use and update the
+  current file position
+@int[opt=0] flags bitwise OR of zero or more of `RWF_APPEND`, `RWF_DSYNC`,
+  `RWF_HIPRI`, `RWF_NOWAIT` and `RWF_SYNC`
+@treturn[1] int number of bytes written, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see pwritev2(2)
+@usage
+  local unistd = require "posix.unistd"
+  unistd.pwritev2 (logfd, {header, payload}, -1, unistd.RWF_DSYNC)
+*/
+static int
+Ppwritev2(lua_State *L)
+{
+	int fd = checkint(L, 1);
+	off_t offset = (off_t)optinteger(L, 3, -1);
+	int flags = optint(L, 4, 0);
+	int niov;
+	struct iovec *iov;
+	ssize_t r;
+	checknargs(L, 4);
+	iov = checkiovec(L, 2, &niov);
+	r = pwritev2(fd, iov, niov, offset, flags);
+	if (r < 0)
+		return pusherror(L, "pwritev2");
+	return pushintegerresult(r);
+}
+#endif
+
+
 /***
 Read bytes from a file.
 @function read
@@ -996,6 +1281,35 @@ Preadlink(lua_State *L)
 }
 
 
+/***
+Read value of a symbolic link relative to a directory descriptor.
+@function readlinkat
+@int dirfd directory that a relative *path* is resolved against, or
+  `posix.fcntl.AT_FDCWD`
+@string path file to act on
+@treturn[1] string link target, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see readlinkat(2)
+@see readlink
+*/
+static int
+Preadlinkat(lua_State *L)
+{
+	char b[PATH_MAX];
+	int dirfd = checkint(L, 1);
+	const char *path = luaL_checkstring(L, 2);
+	ssize_t n;
+	checknargs(L, 2);
+
+	if ((n = readlinkat(dirfd, path, b, sizeof b)) < 0)
+		return pusherror(L, path);
+	lua_pushlstring(L, b, n);
+	return 1;
+}
+
+
 /***
 Remove a directory.
 @function rmdir
@@ -1095,6 +1409,29 @@ Psync(lua_State *L)
 }
 
 
+#if HAVE_SYNCFS
+/***
+Commit the buffer cache of one filesystem to disk.
+Like @{sync}, but only for the filesystem containing *fd*, and reporting
+any writeback errors.
+@function syncfs
+@int fd open file descriptor on the filesystem to flush
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see syncfs(2)
+*/
+static int
+Psyncfs(lua_State *L)
+{
+	int fd = checkint(L, 1);
+	checknargs(L, 1);
+	return pushresult(L, syncfs(fd), "syncfs");
+}
+#endif
+
+
 /***
 Get configuration information at runtime.
 @function sysconf
@@ -1198,6 +1535,33 @@ Punlink(lua_State *L)
 }
 
 
+/***
+Unlink a file or remove a directory relative to a directory descriptor.
+@function unlinkat
+@int dirfd directory that a relative *path* is resolved against, or
+  `posix.fcntl.AT_FDCWD`
+@string path file to act on
+@int[opt=0] flags `0`, or `posix.fcntl.AT_REMOVEDIR` to remove an empty
+  directory
+@treturn[1] int `0`, if successful
+@return[2] nil
+@treturn[2] string error message
+@treturn[2] int errnum
+@see unlinkat(2)
+@see unlink
+@see rmdir
+*/
+static int
+Punlinkat(lua_State *L)
+{
+	int dirfd = checkint(L, 1);
+	const char *path = luaL_checkstring(L, 2);
+	int flags = optint(L, 3, 0);
+	checknargs(L, 3);
+	return pushresult(L, unlinkat(dirfd, path, flags), path);
+}
+
+
 /***
 Write bytes to a file.
 If *nbytes* is `nil` or omitted, write all bytes from *offset*
@@ -1299,6 +1663,7 @@ static const luaL_Reg posix_unistd_fns[] =
 	LPOSIX_FUNC( Pchdir		),
 	LPOSIX_FUNC( Pchown		),
 	LPOSIX_FUNC( Pclose		),
+	LPOSIX_FUNC( Pcommit		),
 #if defined HAVE_CRYPT
 	LPOSIX_FUNC( Pcrypt		),
 #endif
@@ -1308,6 +1673,10 @@ static const luaL_Reg posix_unistd_fns[] =
 	LPOSIX_FUNC( Pexecp		),
 #if HAVE_FDATASYNC
 	LPOSIX_FUNC( Pfdatasync		),
+#endif
+	LPOSIX_FUNC( Pfchownat		),
+#ifdef FIONREAD
+	LPOSIX_FUNC( Pfionread		),
 #endif
 	LPOSIX_FUNC( Pfork		),
 	LPOSIX_FUNC( Pfsync		),
@@ -1335,12 +1704,23 @@ static const luaL_Reg posix_unistd_fns[] =
 	LPOSIX_FUNC( Pnice		),
 	LPOSIX_FUNC( Ppathconf		),
 	LPOSIX_FUNC( Ppipe		),
+#if HAVE_PIPE2
+	LPOSIX_FUNC( Ppipe2		),
+#endif
+#if HAVE_PWRITEV2
+	LPOSIX_FUNC( Ppwritev2		),
+#endif
 	LPOSIX_FUNC( Pread		),
 	LPOSIX_FUNC( Preadlink		),
+	LPOSIX_FUNC( Preadlinkat	),
 	LPOSIX_FUNC( Prmdir		),
 	LPOSIX_FUNC( Psetpid		),
 	LPOSIX_FUNC( Psleep		),
+	LPOSIX_FUNC( Psymlinkat		),
 	LPOSIX_FUNC( Psync		),
+#if HAVE_SYNCFS
+	LPOSIX_FUNC( Psyncfs		),
+#endif
 	LPOSIX_FUNC( Psysconf		),
 	LPOSIX_FUNC( Pttyname		),
 #if LPOSIX_2001_COMPLIANT
@@ -1348,6 +1728,7 @@ static const luaL_Reg posix_unistd_fns[] =
 	LPOSIX_FUNC( Ptcsetpgrp		),
 #endif
 	LPOSIX_FUNC( Punlink		),
+	LPOSIX_FUNC( Punlinkat		),
 	LPOSIX_FUNC( Pwrite		),
 	LPOSIX_FUNC( Pftruncate		),
 	LPOSIX_FUNC( Ptruncate		),
@@ -1383,8 +1764,15 @@ Any constants not available in the underlying system will be `nil` valued.
 @int _SC_STREAM_MAX maximum number of streams per process
 @int _SC_TZNAME_MAX maximum number of timezone types
 @int _SC_VERSION POSIX.1 compliance version
+@int RWF_APPEND append to the end of the file, ignoring the offset
+@int RWF_DSYNC make this write durable, as `O_DSYNC`
+@int RWF_HIPRI poll for completion of this high priority write
+@int RWF_NOWAIT fail with `EAGAIN` rather than block
+@int RWF_SYNC make this write and its metadata durable, as `O_SYNC`
 @int SEEK_CUR relative file pointer position
+@int SEEK_DATA set file pointer to the next data at or after offset
 @int SEEK_END set file pointer to the end of file
+@int SEEK_HOLE set file pointer to the next hole at or after offset
 @int SEEK_SET absolute file pointer position
 @int STDERR_FILENO standard error file descriptor
 @int STDIN_FILENO standard input file descriptor
@@ -1429,10 +1817,33 @@ luaopen_posix_unistd(lua_State *L)
 	LPOSIX_CONST( _SC_TZNAME_MAX	);
 	LPOSIX_CONST( _SC_VERSION	);
 
+	/* pwritev2 flags */
+#ifdef RWF_APPEND
+	LPOSIX_CONST( RWF_APPEND	);
+#endif
+#ifdef RWF_DSYNC
+	LPOSIX_CONST( RWF_DSYNC		);
+#endif
+#ifdef RWF_HIPRI
+	LPOSIX_CONST( RWF_HIPRI		);
+#endif
+#ifdef RWF_NOWAIT
+	LPOSIX_CONST( RWF_NOWAIT	);
+#endif
+#ifdef RWF_SYNC
+	LPOSIX_CONST( RWF_SYNC		);
+#endif
+
 	/* lseek arguments */
 	LPOSIX_CONST( SEEK_CUR		);
 	LPOSIX_CONST( SEEK_END		);
 	LPOSIX_CONST( SEEK_SET		);
+#ifdef SEEK_DATA
+	LPOSIX_CONST( SEEK_DATA		);
+#endif
+#ifdef SEEK_HOLE
+	LPOSIX_CONST( SEEK_HOLE		);
+#endif
 
 	/* Miscellaneous */
 	LPOSIX_CONST( STDERR_FILENO	);
@@ -0,0 +1,440 @@
+--[[
+ POSIX library for Lua 5.1, 5.2, 5.3 & 5.4.
+ Copyright (C) 2014-2025 Gary V. Vaughan
+]]
+--[[--
+ Coroutine-aware non-blocking I/O.
+
+ Drop-in replacements for the blocking descriptor APIs from
+ @{posix.unistd} and @{posix.sys.socket}.  Each wrapper switches its
+ descriptor to `O_NONBLOCK`, and whenever the underlying call fails
+ with `EAGAIN` (or `EINPROGRESS` for `connect`) the running coroutine
+ yields the descriptor and the poll event it is waiting for (`"IN"` or
+ `"OUT"`) to its scheduler, then retries the call when resumed.
+
+ Coroutines started with @{spawn} are driven by a default scheduler
+ built on @{posix.poll.poll}, but any scheduler that resumes a
+ coroutine once the descriptor it yielded is ready will work.  Called
+ from outside a coroutine, the wrappers block in `poll` on the single
+ descriptor instead, so the same code runs with or without a scheduler.
+
+ @module posix.async
+]]
+
+
+local _ENV = require 'posix._strict' {
+   EAGAIN = require 'posix.errno'.EAGAIN,
+   EINPROGRESS = require 'posix.errno'.EINPROGRESS,
+   EINTR = require 'posix.errno'.EINTR,
+   EWOULDBLOCK = require 'posix.errno'.EWOULDBLOCK,
+   F_GETFL = require 'posix.fcntl'.F_GETFL,
+   F_SETFL = require 'posix.fcntl'.F_SETFL,
+   O_NONBLOCK = require 'posix.fcntl'.O_NONBLOCK,
+   SOL_SOCKET = require 'posix.sys.socket'.SOL_SOCKET,
+   SO_ERROR = require 'posix.sys.socket'.SO_ERROR,
+   accept = require 'posix.sys.socket'.accept,
+   argscheck = require 'posix._base'.argscheck,
+   band = require 'posix._base'.band,
+   bor = require 'posix._base'.bor,
+   connect = require 'posix.sys.socket'.connect,
+   create = coroutine.create,
+   errno = require 'posix.errno'.errno,
+   error = error,
+   fcntl = require 'posix.fcntl'.fcntl,
+   getsockopt = require 'posix.sys.socket'.getsockopt,
+   next = next,
+   pcall = pcall,
+   poll = require 'posix.poll'.poll,
+   read = require 'posix.unistd'.read,
+   recv = require 'posix.sys.socket'.recv,
+   recvfrom = require 'posix.sys.socket'.recvfrom,
+   resume = coroutine.resume,
+   running = coroutine.running,
+   select = select,
+   send = require 'posix.sys.socket'.send,
+   sendto = require 'posix.sys.socket'.sendto,
+   setmetatable = setmetatable,
+   status = coroutine.status,
+   unpack = table.unpack or unpack,
+   write = require 'posix.unistd'.write,
+   yield = coroutine.yield,
+}
+
+
+local function setnonblock(fd)
+   local flags, errmsg, errnum = fcntl(fd, F_GETFL)
+   if flags == nil then
+      return nil, errmsg, errnum
+   elseif band(flags, O_NONBLOCK) == 0 then
+      return fcntl(fd, F_SETFL, bor(flags, O_NONBLOCK))
+   end
+   return flags
+end
+
+
+local function Pwait(fd, event)
+   local co, ismain = running()
+   if co ~= nil and not ismain then
+      return yield(fd, event)
+   end
+
+   -- Not in a coroutine, so nothing else can run: block in poll.
+   local fds = {[fd] = {events = {[event] = true}}}
+   local r, errmsg, errnum
+   repeat
+      r, errmsg, errnum = poll(fds, -1)
+   until r ~= nil or errnum ~= EINTR
+   return r, errmsg, errnum
+end
+
+
+-- Call `fn(fd, ...)` until it stops failing with EAGAIN, suspending
+-- until *fd* is ready for *event* between attempts.
+local function retry(event, fn, fd, ...)
+   local r, errmsg, errnum = setnonblock(fd)
+   if r == nil then
+      return nil, errmsg, errnum
+   end
+   while true do
+      r, errmsg, errnum = fn(fd, ...)
+      if r == nil and (errnum == EAGAIN or errnum == EWOULDBLOCK) then
+         Pwait(fd, event)
+      elseif r == nil then
+         return nil, errmsg, errnum
+      elseif errmsg == nil then
+         return r
+      else
+         -- accept and recvfrom also return an address
+         return r, errmsg
+      end
+   end
+end
+
+
+local function Pconnect(fd, addr)
+   local r, errmsg, errnum = setnonblock(fd)
+   if r == nil then
+      return nil, errmsg, errnum
+   end
+   r, errmsg, errnum = connect(fd, addr)
+   if r ~= nil or errnum ~= EINPROGRESS then
+      return r, errmsg, errnum
+   end
+
+   Pwait(fd, 'OUT')
+   r, errmsg, errnum = getsockopt(fd, SOL_SOCKET, SO_ERROR)
+   if r == nil then
+      return nil, errmsg, errnum
+   elseif r ~= 0 then
+      errmsg, errnum = errno(r)
+      return nil, 'connect: ' .. errmsg, errnum
+   end
+   return 0
+end
+
+
+--- Scheduler
+-- @section scheduler
+
+
+-- Wake every coroutine in `waiting[fd]`.
+local function wake(self, waiting, fd)
+   local list = waiting[fd]
+   if list then
+      waiting[fd] = nil
+      local runnable = self.runnable
+      for i = 1, #list do
+         runnable[#runnable + 1] = {list[i]}
+      end
+   end
+end
+
+
+local function dispatch(self, co, ...)
+   local ok, fd, event = resume(co, ...)
+   if not ok then
+      error(fd, 0)
+   elseif status(co) == 'dead' then
+      return
+   end
+
+   local waiting
+   if event == 'IN' then
+      waiting = self.readers
+   elseif event == 'OUT' then
+      waiting = self.writers
+   else
+      -- A bare `coroutine.yield()` just goes to the back of the queue.
+      self.runnable[#self.runnable + 1] = {co}
+      return
+   end
+   local list = waiting[fd]
+   if list == nil then
+      list = {}
+      waiting[fd] = list
+   end
+   list[#list + 1] = co
+end
+
+
+local Scheduler = {
+   --- Add a new coroutine to this scheduler.
+   -- @function Scheduler:spawn
+   -- @func fn body of the new coroutine
+   -- @param ... arguments passed to *fn* when it first runs
+   -- @treturn thread the new coroutine
+   spawn = function(self, fn, ...)
+      local co = create(fn)
+      self.runnable[#self.runnable + 1] = {co, select('#', ...), ...}
+      return co
+   end,
+
+   --- Run all runnable coroutines once, then wait for I/O.
+   -- An error raised by a coroutine is propagated, after requeuing the
+   -- coroutines that this step had not run yet.
+   -- @function Scheduler:step
+   -- @int[opt=-1] timeout maximum milliseconds to wait for descriptors
+   --  to become ready, or `-1` to block indefinitely
+   -- @treturn[1] bool `true` if there are still coroutines to run
+   -- @treturn[2] bool `false` once every coroutine has finished
+   -- @return[3] nil
+   -- @treturn[3] string error message
+   -- @treturn[3] int errnum
+   step = function(self, timeout)
+      local queue = self.runnable
+      self.runnable = {}
+      for i = 1, #queue do
+         local t = queue[i]
+         local ok, err = pcall(dispatch, self, t[1], unpack(t, 3, 2 + (t[2] or 0)))
+         if not ok then
+            -- Unreached coroutines go ahead of any queued since.
+            local rest = {}
+            for j = i + 1, #queue do
+               rest[#rest + 1] = queue[j]
+            end
+            for j = 1, #self.runnable do
+               rest[#rest + 1] = self.runnable[j]
+            end
+            self.runnable = rest
+            error(err, 0)
+         end
+      end
+
+      local readers, writers = self.readers, self.writers
+      if next(readers) == nil and next(writers) == nil then
+         return #self.runnable > 0
+      end
+
+      local fds = {}
+      for fd in next, readers do
+         fds[fd] = {events = {IN = true}}
+      end
+      for fd in next, writers do
+         local t = fds[fd] or {events = {}}
+         t.events.OUT = true
+         fds[fd] = t
+      end
+
+      local r, errmsg, errnum = poll(fds, #self.runnable > 0 and 0 or timeout or -1)
+      if r == nil and errnum ~= EINTR then
+         return nil, errmsg, errnum
+      end
+      for fd, t in next, fds do
+         local revents = t.revents
+         if revents then
+            local failed = revents.ERR or revents.HUP or revents.NVAL
+            if revents.IN or failed then
+               wake(self, readers, fd)
+            end
+            if revents.OUT or failed then
+               wake(self, writers, fd)
+            end
+         end
+      end
+      return true
+   end,
+
+   --- Run until every coroutine has finished.
+   -- Errors raised inside a coroutine are propagated to the caller.
+   -- @function Scheduler:run
+   -- @treturn[1] bool `true`, if successful
+   -- @return[2] nil
+   -- @treturn[2] string error message
+   -- @treturn[2] int errnum
+   run = function(self)
+      local more, errmsg, errnum
+      repeat
+         more, errmsg, errnum = self:step(-1)
+      until not more
+      if more == nil then
+         return nil, errmsg, errnum
+      end
+      return true
+   end,
+}
+Scheduler.__index = Scheduler
+
+
+local function Pscheduler()
+   return setmetatable({runnable = {}, readers = {}, writers = {}}, Scheduler)
+end
+
+
+local default = Pscheduler()
+
+
+return {
+   --- Functions
+   -- @section functions
+
+   --- Accept a connection on a socket without blocking other coroutines.
+   -- @function accept
+   -- @int fd socket descriptor to act on
+   -- @treturn[1] int connection descriptor
+   -- @treturn[1] table connection address, if successful
+   -- @return[2] nil
+   -- @treturn[2] string error message
+   -- @treturn[2] int errnum
+   -- @see posix.sys.socket.accept
+   accept = argscheck('accept(int)', function(fd)
+      return retry('IN', accept, fd)
+   end),
+
+   --- Initiate a connection on a socket without blocking other coroutines.
+   -- @function connect
+   -- @int fd socket descriptor to act on
+   -- @tparam sockaddr addr socket address
+   -- @treturn[1] int `0`, if successful
+   -- @return[2] nil
+   -- @treturn[2] string error message
+   -- @treturn[2] int errnum
+   -- @see posix.sys.socket.connect
+   connect = argscheck('connect(int, table)', Pconnect),
+
+   --- Read bytes from a file without blocking other coroutines.
+   -- @function read
+   -- @int fd the file descriptor to act on
+   -- @int count maximum number of bytes to read
+   -- @treturn[1] string string from *fd* with at most *count* bytes, if successful
+   -- @return[2] nil
+   -- @treturn[2] string error message
+   -- @treturn[2] int errnum
+   -- @see posix.unistd.read
+   read = argscheck('read(int, int)', function(fd, count)
+      return retry('IN', read, fd, count)
+   end),
+
+   --- Receive a message from a socket without blocking other coroutines.
+   -- @function recv
+   -- @int fd socket descriptor to act on
+   -- @int count maximum number of bytes to receive
+   -- @treturn[1] string received bytes, if successful
+   -- @return[2] nil
+   -- @treturn[2] string error message
+   -- @treturn[2] int errnum
+   -- @see posix.sys.socket.recv
+   recv = argscheck('recv(int, int)', function(fd, count)
+      return retry('IN', recv, fd, count)
+   end),
+
+   --- Receive a message from a socket without blocking other coroutines.
+   -- @function recvfrom
+   -- @int fd socket descriptor to act on
+   -- @int count maximum number of bytes to receive
+   -- @treturn[1] string received bytes
+   -- @treturn[1] sockaddr address of message source, if successful
+   -- @return[2] nil
+   -- @treturn[2] string error message
+   -- @treturn[2] int errnum
+   -- @see posix.sys.socket.recvfrom
+   recvfrom = argscheck('recvfrom(int, int)', function(fd, count)
+      return retry('IN', recvfrom, fd, count)
+   end),
+
+   --- Run the default scheduler until every coroutine has finished.
+   -- @function run
+   -- @treturn[1] bool `true`, if successful
+   -- @return[2] nil
+   -- @treturn[2] string error message
+   -- @treturn[2] int errnum
+   -- @see Scheduler:run
+   run = argscheck('run()', function()
+      return default:run()
+   end),
+
+   --- Create a new poll based scheduler.
+   -- @function scheduler
+   -- @treturn Scheduler a new scheduler with no coroutines
+   -- @usage
+   --   local async = require 'posix.async'
+   --   local sched = async.scheduler()
+   --   sched:spawn(function() print(async.read(0, 80)) end)
+   --   sched:run()
+   scheduler = argscheck('scheduler()', Pscheduler),
+
+   --- Send a message from a socket without blocking other coroutines.
+   -- @function send
+   -- @int fd socket descriptor to act on
+   -- @string buffer message bytes to send
+   -- @treturn[1] int number of bytes sent, if successful
+   -- @return[2] nil
+   -- @treturn[2] string error message
+   -- @treturn[2] int errnum
+   -- @see posix.sys.socket.send
+   send = argscheck('send(int, string)', function(fd, buffer)
+      return retry('OUT', send, fd, buffer)
+   end),
+
+   --- Send a message from a socket without blocking other coroutines.
+   -- @function sendto
+   -- @int fd socket descriptor to act on
+   -- @string buffer message bytes to send
+   -- @tparam sockaddr destination socket address
+   -- @treturn[1] int number of bytes sent, if successful
+   -- @return[2] nil
+   -- @treturn[2] string error message
+   -- @treturn[2] int errnum
+   -- @see posix.sys.socket.sendto
+   sendto = argscheck('sendto(int, string, table)', function(fd, buffer, addr)
+      return retry('OUT', sendto, fd, buffer, addr)
+   end),
+
+   --- Add a new coroutine to the default scheduler.
+   -- @function spawn
+   -- @func fn body of the new coroutine
+   -- @param ... arguments passed to *fn* when it first runs
+   -- @treturn thread the new coroutine
+   -- @usage
+   --   local async = require 'posix.async'
+   --   local unistd = require 'posix.unistd'
+   --   local r, w = unistd.pipe()
+   --   async.spawn(function() print(async.read(r, 80)) end)
+   --   async.spawn(function() async.write(w, 'hello') end)
+   --   async.run()
+   spawn = argscheck('spawn(function, [any...])', function(fn, ...)
+      return default:spawn(fn, ...)
+   end),
+
+   --- Suspend the running coroutine until a descriptor is ready.
+   -- Outside of a coroutine, block in @{posix.poll.poll} instead.
+   -- @function wait
+   -- @int fd descriptor to wait for
+   -- @string event `"IN"` to wait until *fd* is readable, or `"OUT"`
+   --  until it is writable
+   wait = argscheck('wait(int, string)', Pwait),
+
+   --- Write bytes to a file without blocking other coroutines.
+   -- @function write
+   -- @int fd the file descriptor to act on
+   -- @string buf containing bytes to write
+   -- @int[opt=#buf] nbytes number of bytes to write
+   -- @int[opt=0] offset skip the first offset bytes of buf
+   -- @treturn[1] int number of bytes written, if successful
+   -- @return[2] nil
+   -- @treturn[2] string error message
+   -- @treturn[2] int errnum
+   -- @see posix.unistd.write
+   write = argscheck('write(int, string, [?int], [?int])', function(fd, ...)
+      return retry('OUT', write, fd, ...)
+   end),
+}
@@ -20,7 +20,7 @@
 
 
 local _ENV = require 'posix._strict' {
-   GLOB_MARK = require 'posix.glob'.GLOB_MARK,
+   F_SETFD = require 'posix.fcntl'.F_SETFD,
    O_NOCTTY = require 'posix.fcntl'.O_NOCTTY,
    O_RDWR = require 'posix.fcntl'.O_RDWR,
    STDIN_FILENO = require 'posix.unistd'.STDIN_FILENO,
@@ -36,12 +36,14 @@ local _ENV = require 'posix._strict' {
    error = error,
    execp = require 'posix.unistd'.execp,
    exit = os.exit,
+   fcntl = require 'posix.fcntl'.fcntl,
    fork = require 'posix.unistd'.fork,
    getegid = require 'posix.unistd'.getegid,
    geteuid = require 'posix.unistd'.geteuid,
    getgid = require 'posix.unistd'.getgid,
    getuid= require 'posix.unistd'.getuid,
    glob = require 'posix.glob'.glob,
+   globconst = require 'posix.glob',
    grantpt = require 'posix.stdlib'.grantpt,
    gsub = string.gsub,
    insert = table.insert,
@@ -58,6 +60,7 @@ local _ENV = require 'posix._strict' {
    require = require,
    set_errno = require 'posix.errno'.set_errno,
    setmetatable = setmetatable,
+   spawn_pipeline = require 'posix.spawn'.pipeline,
    stat = require 'posix.sys.stat'.stat,
    sub = string.sub,
    tonumber = tonumber,
@@ -68,8 +71,8 @@ local _ENV = require 'posix._strict' {
 
 
 -- FIXME: specl-14.x breaks function environments here :(
-local GLOB_MARK, STDIN_FILENO, STDOUT_FILENO, _exit, close, errno, execp, exit, fork, glob, insert, pipe, remove, wait =
-   GLOB_MARK, STDIN_FILENO, STDOUT_FILENO, _exit, close, errno, execp, exit, fork, glob, insert, pipe, remove, wait
+local F_SETFD, STDIN_FILENO, STDOUT_FILENO, _exit, close, errno, execp, exit, fcntl, fork, glob, globconst, insert, pipe, remove, spawn_pipeline, wait =
+   F_SETFD, STDIN_FILENO, STDOUT_FILENO, _exit, close, errno, execp, exit, fcntl, fork, glob, globconst, insert, pipe, remove, spawn_pipeline, wait
 
 
 local function Peuidaccess(file, mode)
@@ -128,6 +131,8 @@ local function Pexecx(task, ...)
 end
 
 
+local globflags = {'BRACE', 'MARK', 'NOSORT', 'ONLYDIR', 'TILDE'}
+
 local function Pglob(args)
    -- Support previous `glob '.*'` style calls.
    if type(args) == 'string' then
@@ -136,8 +141,11 @@ local function Pglob(args)
       args = {}
    end
    local flags = 0
-   if args.MARK then
-      flags = GLOB_MARK
+   for i = 1, #globflags do
+      local k = globflags[i]
+      if args[k] and globconst['GLOB_' .. k] then
+         flags = bor(flags, globconst['GLOB_' .. k])
+      end
    end
    return glob(args.pattern, flags)
 end
@@ -213,6 +221,29 @@ end
 
 
 local function Ppopen_pipeline(tasks, mode, pipe_fn)
+   -- Spawn pipelines of plain commands directly, without forking a Lua
+   -- process per stage; otherwise, or if that fails, fork and exec so
+   -- that a failed stage exits with errno as before.
+   if pipe_fn == nil and type(tasks) == 'table' and (mode == 'r' or mode == 'w') then
+      local native = #tasks > 0
+      for i = 1, #tasks do
+         native = native and type(tasks[i]) == 'table'
+      end
+      local pfd = native and spawn_pipeline(tasks, mode)
+      if pfd then
+         -- Match the fork path below: an inheritable fd and, for "w",
+         -- pids listed last stage first, so pclose reports the first.
+         fcntl(pfd.fd, F_SETFD, 0)
+         if mode == 'w' then
+            local pids, n = pfd.pids, #pfd.pids
+            for i = 1, n / 2 do
+               pids[i], pids[n + 1 - i] = pids[n + 1 - i], pids[i]
+            end
+         end
+         return pfd
+      end
+   end
+
    local first, from, to, inc = 1, 2, #tasks, 1
    if mode == 'w' then
       first, from, to, inc = #tasks, #tasks - 1, 1, -1
@@ -337,12 +368,15 @@ local M = {
    execx = argscheck('execx(function|table, [any...])', Pexecx),
 
    --- Find all files in this directory matching a shell pattern.
-   -- The flag MARK appends a trailing slash to matches that are directories.
+   -- The flag MARK appends a trailing slash to matches that are directories,
+   -- and NOSORT, ONLYDIR, BRACE and TILDE select the corresponding `GLOB_*`
+   -- flags, where supported.
    -- @function glob
    -- @tparam table|string|nil args the three possible parameters can be used to
    -- override the default values for `pattern` and `MARK`, which are `"*"` and
-   -- `false` respectively. A table will be checked for optional keys `pattern`
-   -- and `MARK`. A string will be used as the glob pattern.
+   -- `false` respectively. A table will be checked for optional keys `pattern`,
+   -- `MARK`, `NOSORT`, `ONLYDIR`, `BRACE` and `TILDE`. A string will be used as
+   -- the glob pattern.
    -- @treturn[1] table matching files and directories, if successful
    -- @return[2] nil
    -- @treturn[2] one of `GLOB_BORTED`, `GLOB_NOMATCH` or `GLOB_NOSPACE`
@@ -420,11 +454,12 @@ local M = {
 
 do
    local names = {
-      'ctype', 'dirent', 'errno', 'fcntl', 'fnmatch', 'glob', 'grp',
-      'libgen', 'poll', 'pwd', 'sched', 'signal', 'stdio', 'stdlib', 'sys.msg',
-      'sys.resource', 'sys.socket', 'sys.stat', 'sys.statvfs', 'sys.time',
-      'sys.times', 'sys.utsname', 'sys.wait', 'syslog', 'termio', 'time',
-      'unistd', 'utime'
+      'ctype', 'deadline', 'dirent', 'errno', 'fcntl', 'fnmatch', 'fsops',
+      'glob', 'grp', 'libgen', 'poll', 'prefork', 'pwd', 'sched', 'signal',
+      'spawn', 'stdio', 'stdlib', 'sys.eventfd', 'sys.inotify', 'sys.msg',
+      'sys.pidfd', 'sys.resource', 'sys.socket', 'sys.stat', 'sys.statvfs',
+      'sys.time', 'sys.timerfd', 'sys.times', 'sys.utsname', 'sys.wait',
+      'syslog', 'termio', 'time', 'unistd', 'utime'
    }
    for i = 1, #names do
       local name = names[i]